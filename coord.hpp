@@ -0,0 +1,564 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cubie-level cube and the coordinates the solvers search over.
+// A CubieCube stores which corner/edge sits in each position and its orientation, using the
+// usual URF..DRB / UR..BR numbering. Coordinates index parts of that state (orientations, the
+// UD-slice edge positions, permutations) and every coordinate has a uint16_t [N][18] move table,
+// built in parallel on first use and cached in the user cache directory afterwards.
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <utility>
+
+#include "cube.hpp"
+#include "parallel.hpp"
+#include "tablecache.hpp"
+
+namespace cube {
+    enum Corner {
+        CORNER_URF, CORNER_UFL, CORNER_ULB, CORNER_UBR, CORNER_DFR, CORNER_DLF, CORNER_DBL, CORNER_DRB,
+        CORNER_COUNT
+    };
+
+    enum Edge {
+        EDGE_UR, EDGE_UF, EDGE_UL, EDGE_UB, EDGE_DR, EDGE_DF, EDGE_DL, EDGE_DB,
+        EDGE_FR, EDGE_FL, EDGE_BL, EDGE_BR,
+        EDGE_COUNT
+    };
+
+    // Facelet index from a face and its 1-9 sticker number
+    constexpr int facelet(int face, int n) { return face * FACELETS_PER_FACE + n - 1; }
+
+    // Facelets of each corner/edge position, starting with the U/D (or F/B for slice edges) one
+    // and going clockwise around corners
+    constexpr uint8_t CORNER_FACELETS[CORNER_COUNT][3] = {
+        {facelet(FACE_U, 9), facelet(FACE_R, 1), facelet(FACE_F, 3)}, {facelet(FACE_U, 7), facelet(FACE_F, 1), facelet(FACE_L, 3)},
+        {facelet(FACE_U, 1), facelet(FACE_L, 1), facelet(FACE_B, 3)}, {facelet(FACE_U, 3), facelet(FACE_B, 1), facelet(FACE_R, 3)},
+        {facelet(FACE_D, 3), facelet(FACE_F, 9), facelet(FACE_R, 7)}, {facelet(FACE_D, 1), facelet(FACE_L, 9), facelet(FACE_F, 7)},
+        {facelet(FACE_D, 7), facelet(FACE_B, 9), facelet(FACE_L, 7)}, {facelet(FACE_D, 9), facelet(FACE_R, 9), facelet(FACE_B, 7)}
+    };
+
+    constexpr uint8_t EDGE_FACELETS[EDGE_COUNT][2] = {
+        {facelet(FACE_U, 6), facelet(FACE_R, 2)}, {facelet(FACE_U, 8), facelet(FACE_F, 2)},
+        {facelet(FACE_U, 4), facelet(FACE_L, 2)}, {facelet(FACE_U, 2), facelet(FACE_B, 2)},
+        {facelet(FACE_D, 6), facelet(FACE_R, 8)}, {facelet(FACE_D, 2), facelet(FACE_F, 8)},
+        {facelet(FACE_D, 4), facelet(FACE_L, 8)}, {facelet(FACE_D, 8), facelet(FACE_B, 8)},
+        {facelet(FACE_F, 6), facelet(FACE_R, 4)}, {facelet(FACE_F, 4), facelet(FACE_L, 6)},
+        {facelet(FACE_B, 6), facelet(FACE_L, 4)}, {facelet(FACE_B, 4), facelet(FACE_R, 6)}
+    };
+
+    constexpr uint8_t CORNER_COLORS[CORNER_COUNT][3] = {
+        {FACE_U, FACE_R, FACE_F}, {FACE_U, FACE_F, FACE_L}, {FACE_U, FACE_L, FACE_B}, {FACE_U, FACE_B, FACE_R},
+        {FACE_D, FACE_F, FACE_R}, {FACE_D, FACE_L, FACE_F}, {FACE_D, FACE_B, FACE_L}, {FACE_D, FACE_R, FACE_B}
+    };
+
+    constexpr uint8_t EDGE_COLORS[EDGE_COUNT][2] = {
+        {FACE_U, FACE_R}, {FACE_U, FACE_F}, {FACE_U, FACE_L}, {FACE_U, FACE_B},
+        {FACE_D, FACE_R}, {FACE_D, FACE_F}, {FACE_D, FACE_L}, {FACE_D, FACE_B},
+        {FACE_F, FACE_R}, {FACE_F, FACE_L}, {FACE_B, FACE_L}, {FACE_B, FACE_R}
+    };
+
+    // cp[i]/ep[i] is the cubie in position i, co/eo its twist (0-2) or flip (0-1)
+    struct CubieCube {
+        uint8_t cp[CORNER_COUNT], co[CORNER_COUNT];
+        uint8_t ep[EDGE_COUNT], eo[EDGE_COUNT];
+    };
+
+    constexpr CubieCube solvedCubie() {
+        CubieCube c{};
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            c.cp[i] = i;
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            c.ep[i] = i;
+        }
+        return c;
+    }
+
+    // a followed by b
+    constexpr CubieCube multiply(const CubieCube &a, const CubieCube &b) {
+        CubieCube c{};
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            c.cp[i] = a.cp[b.cp[i]];
+            c.co[i] = (a.co[b.cp[i]] + b.co[i]) % 3;
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            c.ep[i] = a.ep[b.ep[i]];
+            c.eo[i] = (a.eo[b.ep[i]] + b.eo[i]) % 2;
+        }
+        return c;
+    }
+
+    // Cubie identified by the colors of its facelets: a corner by the two colors clockwise after
+    // its U/D color, an edge by its two colors in position order with the flip in bit 4
+    struct CubieLookup {
+        uint8_t corner[FACE_ID_COUNT][FACE_ID_COUNT];
+        uint8_t edge[FACE_ID_COUNT][FACE_ID_COUNT];
+    };
+
+    constexpr uint8_t NO_CUBIE = 0xFF;
+    constexpr uint8_t EDGE_FLIPPED = 0x10;
+
+    constexpr CubieLookup buildCubieLookup() {
+        CubieLookup lookup{};
+        for (int a = 0; a < FACE_ID_COUNT; a++) {
+            for (int b = 0; b < FACE_ID_COUNT; b++) {
+                lookup.corner[a][b] = NO_CUBIE;
+                lookup.edge[a][b] = NO_CUBIE;
+            }
+        }
+        for (int j = 0; j < CORNER_COUNT; j++) {
+            lookup.corner[CORNER_COLORS[j][1]][CORNER_COLORS[j][2]] = j;
+        }
+        for (int j = 0; j < EDGE_COUNT; j++) {
+            lookup.edge[EDGE_COLORS[j][0]][EDGE_COLORS[j][1]] = j;
+            lookup.edge[EDGE_COLORS[j][1]][EDGE_COLORS[j][0]] = j | EDGE_FLIPPED;
+        }
+        return lookup;
+    }
+
+    inline constexpr CubieLookup CUBIE_LOOKUP = buildCubieLookup();
+
+    // Returns false for facelet states that are not made of real cubies
+    constexpr bool faceletToCubie(const CubeState &state, CubieCube &c) {
+        const uint8_t *f = state.facelets;
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            int ori = 0;
+            while (ori < 3 && f[CORNER_FACELETS[i][ori]] != FACE_U && f[CORNER_FACELETS[i][ori]] != FACE_D) {
+                ori++;
+            }
+            if (ori == 3) {
+                return false;
+            }
+
+            uint8_t corner = CUBIE_LOOKUP.corner[f[CORNER_FACELETS[i][(ori + 1) % 3]]][f[CORNER_FACELETS[i][(ori + 2) % 3]]];
+            if (corner == NO_CUBIE) {
+                return false;
+            }
+            c.cp[i] = corner;
+            c.co[i] = ori;
+        }
+
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            uint8_t edge = CUBIE_LOOKUP.edge[f[EDGE_FACELETS[i][0]]][f[EDGE_FACELETS[i][1]]];
+            if (edge == NO_CUBIE) {
+                return false;
+            }
+            c.ep[i] = edge & ~EDGE_FLIPPED;
+            c.eo[i] = edge & EDGE_FLIPPED ? 1 : 0;
+        }
+        return true;
+    }
+
+    constexpr CubeState cubieToFacelet(const CubieCube &c) {
+        CubeState state = solvedState();
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            for (int n = 0; n < 3; n++) {
+                state.facelets[CORNER_FACELETS[i][(n + c.co[i]) % 3]] = CORNER_COLORS[c.cp[i]][n];
+            }
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            for (int n = 0; n < 2; n++) {
+                state.facelets[EDGE_FACELETS[i][(n + c.eo[i]) % 2]] = EDGE_COLORS[c.ep[i]][n];
+            }
+        }
+        return state;
+    }
+
+    // The 18 face turns at cubie level, read off the facelet permutations
+    struct MoveCubies {
+        CubieCube move[MOVE_COUNT];
+    };
+
+    constexpr MoveCubies buildMoveCubies() {
+        MoveCubies cubies{};
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            CubeState solved = solvedState();
+            CubeState turned{};
+            for (int i = 0; i < FACELET_COUNT; i++) {
+                turned.facelets[i] = solved.facelets[MOVE_TABLES.perm[move][i]];
+            }
+            faceletToCubie(turned, cubies.move[move]);
+        }
+        return cubies;
+    }
+
+    inline constexpr MoveCubies MOVE_CUBIES = buildMoveCubies();
+
+    // Moves that keep a cube in the phase 2 subgroup <U, D, R2, L2, F2, B2>
+    constexpr bool isPhase2Move(int move) {
+        return moveFace(move) == FACE_U || moveFace(move) == FACE_D || move % 3 == 1;
+    }
+
+    /* Coordinates */
+
+    constexpr int TWIST_COUNT = 2187;        // 3^7 corner orientations
+    constexpr int FLIP_COUNT = 2048;         // 2^11 edge orientations
+    constexpr int SLICE_COUNT = 495;         // C(12,4) positions of the FR, FL, BL, BR edges
+    constexpr int CORNER_PERM_COUNT = 40320; // 8! corner permutations
+    constexpr int UD_EDGE_PERM_COUNT = 40320; // 8! permutations of the U/D layer edges in phase 2
+    constexpr int SLICE_PERM_COUNT = 24;     // 4! permutations of the slice edges in phase 2
+
+    constexpr int binomial(int n, int k) {
+        if (k < 0 || k > n) {
+            return 0;
+        }
+        int result = 1;
+        for (int i = 0; i < k; i++) {
+            result = result * (n - i) / (i + 1);
+        }
+        return result;
+    }
+
+    struct BinomialTable {
+        int16_t value[EDGE_COUNT + 1][5];
+    };
+
+    constexpr BinomialTable buildBinomialTable() {
+        BinomialTable table{};
+        for (int n = 0; n <= EDGE_COUNT; n++) {
+            for (int k = 0; k < 5; k++) {
+                table.value[n][k] = binomial(n, k);
+            }
+        }
+        return table;
+    }
+
+    // C(n, k) for the slice coordinate, n <= 12 and k <= 4
+    inline constexpr BinomialTable SLICE_BINOMIAL = buildBinomialTable();
+
+    // Lehmer code of values[0..n) over 0..n-1 (any distinct values, compared by order)
+    constexpr int permutationIndex(const uint8_t *values, int n) {
+        int index = 0;
+        for (int i = 0; i < n; i++) {
+            int smaller = 0;
+            for (int j = i + 1; j < n; j++) {
+                smaller += values[j] < values[i];
+            }
+            index = index * (n - i) + smaller;
+        }
+        return index;
+    }
+
+    // Inverse of permutationIndex for the values base..base+n-1
+    constexpr void setPermutation(uint8_t *values, int n, int index, int base) {
+        int digits[12] = {};
+        for (int i = n - 1; i >= 0; i--) {
+            digits[i] = index % (n - i);
+            index /= n - i;
+        }
+
+        bool used[12] = {};
+        for (int i = 0; i < n; i++) {
+            int remaining = digits[i];
+            int v = 0;
+            while (used[v] || remaining > 0) {
+                if (!used[v]) {
+                    remaining--;
+                }
+                v++;
+            }
+            used[v] = true;
+            values[i] = base + v;
+        }
+    }
+
+    constexpr int getTwist(const CubieCube &c) {
+        int twist = 0;
+        for (int i = 0; i < CORNER_COUNT - 1; i++) {
+            twist = twist * 3 + c.co[i];
+        }
+        return twist;
+    }
+
+    constexpr void setTwist(CubieCube &c, int twist) {
+        int sum = 0;
+        for (int i = CORNER_COUNT - 2; i >= 0; i--) {
+            c.co[i] = twist % 3;
+            sum += c.co[i];
+            twist /= 3;
+        }
+        c.co[CORNER_COUNT - 1] = (3 - sum % 3) % 3;
+    }
+
+    constexpr int getFlip(const CubieCube &c) {
+        int flip = 0;
+        for (int i = 0; i < EDGE_COUNT - 1; i++) {
+            flip = flip * 2 + c.eo[i];
+        }
+        return flip;
+    }
+
+    constexpr void setFlip(CubieCube &c, int flip) {
+        int sum = 0;
+        for (int i = EDGE_COUNT - 2; i >= 0; i--) {
+            c.eo[i] = flip % 2;
+            sum += c.eo[i];
+            flip /= 2;
+        }
+        c.eo[EDGE_COUNT - 1] = sum % 2;
+    }
+
+    // Which 4 positions hold the slice edges; 0 when they are all in the slice
+    constexpr int getSlice(const CubieCube &c) {
+        int slice = 0;
+        int found = 0;
+        for (int j = EDGE_COUNT - 1; j >= 0; j--) {
+            if (c.ep[j] >= EDGE_FR) {
+                slice += SLICE_BINOMIAL.value[EDGE_COUNT - 1 - j][found + 1];
+                found++;
+            }
+        }
+        return slice;
+    }
+
+    constexpr void setSlice(CubieCube &c, int slice) {
+        const uint8_t EMPTY = 0xFF;
+        for (int j = 0; j < EDGE_COUNT; j++) {
+            c.ep[j] = EMPTY;
+        }
+
+        int remaining = 3;
+        int sliceEdge = EDGE_FR;
+        for (int j = 0; j < EDGE_COUNT; j++) {
+            if (remaining >= 0 && slice - binomial(EDGE_COUNT - 1 - j, remaining + 1) >= 0) {
+                c.ep[j] = sliceEdge++;
+                slice -= binomial(EDGE_COUNT - 1 - j, remaining + 1);
+                remaining--;
+            }
+        }
+
+        int otherEdge = EDGE_UR;
+        for (int j = 0; j < EDGE_COUNT; j++) {
+            if (c.ep[j] == EMPTY) {
+                c.ep[j] = otherEdge++;
+            }
+        }
+    }
+
+    constexpr int getCornerPerm(const CubieCube &c) { return permutationIndex(c.cp, CORNER_COUNT); }
+    constexpr void setCornerPerm(CubieCube &c, int index) { setPermutation(c.cp, CORNER_COUNT, index, 0); }
+
+    // Only meaningful in phase 2, where positions UR..DB hold the U/D edges
+    constexpr int getUdEdgePerm(const CubieCube &c) { return permutationIndex(c.ep, EDGE_FR); }
+    constexpr void setUdEdgePerm(CubieCube &c, int index) { setPermutation(c.ep, EDGE_FR, index, 0); }
+
+    constexpr int getSlicePerm(const CubieCube &c) { return permutationIndex(c.ep + EDGE_FR, EDGE_COUNT - EDGE_FR); }
+    constexpr void setSlicePerm(CubieCube &c, int index) { setPermutation(c.ep + EDGE_FR, EDGE_COUNT - EDGE_FR, index, EDGE_FR); }
+
+    // 1 for an odd permutation of 0..n-1, from its cycles: a cycle of length k is k - 1 swaps
+    constexpr int permutationParity(const uint8_t *values, int n) {
+        uint32_t visited = 0;
+        int parity = 0;
+        for (int i = 0; i < n; i++) {
+            int length = 0;
+            for (int j = i; !(visited >> j & 1); j = values[j]) {
+                visited |= 1u << j;
+                length++;
+            }
+            parity ^= length > 0 ? (length - 1) & 1 : 0;
+        }
+        return parity;
+    }
+
+    // A cubie cube is reachable exactly when every cubie appears once, the permutation parities
+    // match and the twist and flip sums are 0 (mod 3 and 2)
+    constexpr bool isSolvable(const CubieCube &c) {
+        int twist = 0, flip = 0;
+        uint32_t corners = 0, edges = 0;
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            twist += c.co[i];
+            corners |= 1u << c.cp[i];
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            flip += c.eo[i];
+            edges |= 1u << c.ep[i];
+        }
+        return corners == (1u << CORNER_COUNT) - 1 && edges == (1u << EDGE_COUNT) - 1 &&
+               permutationParity(c.cp, CORNER_COUNT) == permutationParity(c.ep, EDGE_COUNT) && twist % 3 == 0 && flip % 2 == 0;
+    }
+
+    // Uniformly random reachable state. Both permutations are Fisher-Yates shuffles whose parity
+    // is counted from their swaps; when they differ the last two edges are exchanged, which maps
+    // the 12! edge permutations 2 to 1 onto those of the needed parity and so stays uniform.
+    // The orientation coordinates are uniform and fix the last corner's twist and edge's flip.
+    template <typename Rng>
+    CubieCube randomCubie(Rng &rng) {
+        CubieCube c = solvedCubie();
+        int parity = 0;
+        for (int i = CORNER_COUNT - 1; i > 0; i--) {
+            int j = std::uniform_int_distribution<int>(0, i)(rng);
+            std::swap(c.cp[i], c.cp[j]);
+            parity ^= i != j;
+        }
+        for (int i = EDGE_COUNT - 1; i > 0; i--) {
+            int j = std::uniform_int_distribution<int>(0, i)(rng);
+            std::swap(c.ep[i], c.ep[j]);
+            parity ^= i != j;
+        }
+        if (parity) {
+            std::swap(c.ep[EDGE_COUNT - 2], c.ep[EDGE_COUNT - 1]);
+        }
+
+        setTwist(c, std::uniform_int_distribution<int>(0, TWIST_COUNT - 1)(rng));
+        setFlip(c, std::uniform_int_distribution<int>(0, FLIP_COUNT - 1)(rng));
+        return c;
+    }
+
+    /* Move tables */
+
+    // Entries for moves outside the phase 2 subgroup are NO_COORD in the phase 2 tables
+    constexpr uint16_t NO_COORD = 0xFFFF;
+    constexpr uint32_t COORD_MOVE_TABLES_VERSION = 1;
+
+    struct CoordMoveTables {
+        uint16_t twist[TWIST_COUNT][MOVE_COUNT];
+        uint16_t flip[FLIP_COUNT][MOVE_COUNT];
+        uint16_t slice[SLICE_COUNT][MOVE_COUNT];
+        uint16_t cornerPerm[CORNER_PERM_COUNT][MOVE_COUNT];
+        uint16_t udEdgePerm[UD_EDGE_PERM_COUNT][MOVE_COUNT];
+        uint16_t slicePerm[SLICE_PERM_COUNT][MOVE_COUNT];
+    };
+
+    struct TableLoadStats {
+        bool fromCache = false;
+        double seconds = 0.0;
+        int threads = 0;
+    };
+
+    template <typename Set, typename Get>
+    void buildMoveTable(uint16_t (*table)[MOVE_COUNT], int count, bool phase2Only, Set set, Get get, int threads) {
+        parallel::parallelFor(0, count, [&](size_t coord) {
+            CubieCube c = solvedCubie();
+            set(c, static_cast<int>(coord));
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                if (phase2Only && !isPhase2Move(move)) {
+                    table[coord][move] = NO_COORD;
+                    continue;
+                }
+                table[coord][move] = get(multiply(c, MOVE_CUBIES.move[move]));
+            }
+        }, threads);
+    }
+
+    inline void buildCoordMoveTables(CoordMoveTables &tables, int threads = parallel::threadCount()) {
+        buildMoveTable(tables.twist, TWIST_COUNT, false, setTwist, getTwist, threads);
+        buildMoveTable(tables.flip, FLIP_COUNT, false, setFlip, getFlip, threads);
+        buildMoveTable(tables.slice, SLICE_COUNT, false, setSlice, getSlice, threads);
+        buildMoveTable(tables.cornerPerm, CORNER_PERM_COUNT, false, setCornerPerm, getCornerPerm, threads);
+        buildMoveTable(tables.udEdgePerm, UD_EDGE_PERM_COUNT, true, setUdEdgePerm, getUdEdgePerm, threads);
+        buildMoveTable(tables.slicePerm, SLICE_PERM_COUNT, true, setSlicePerm, getSlicePerm, threads);
+    }
+
+    // Loaded from the cache or built (and cached) on first use
+    inline const CoordMoveTables &coordMoveTables(TableLoadStats *stats = nullptr) {
+        static TableLoadStats loadStats;
+        static std::unique_ptr<CoordMoveTables> tables = [] {
+            std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+            std::unique_ptr<CoordMoveTables> loaded(new CoordMoveTables);
+
+            loadStats.fromCache = tablecache::readTable("coord-move-tables.bin", COORD_MOVE_TABLES_VERSION, loaded.get(), sizeof(CoordMoveTables));
+            if (!loadStats.fromCache) {
+                loadStats.threads = parallel::threadCount();
+                buildCoordMoveTables(*loaded, loadStats.threads);
+                tablecache::writeTable("coord-move-tables.bin", COORD_MOVE_TABLES_VERSION, loaded.get(), sizeof(CoordMoveTables));
+            }
+
+            loadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return loaded;
+        }();
+
+        if (stats) {
+            *stats = loadStats;
+        }
+        return *tables;
+    }
+
+    /* Compile-time checks */
+
+    constexpr bool corners(const CubieCube &c, const uint8_t (&cp)[CORNER_COUNT], const uint8_t (&co)[CORNER_COUNT]) {
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            if (c.cp[i] != cp[i] || c.co[i] != co[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool faceletsShareCubies() {
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            for (int n = 1; n < 3; n++) {
+                if (!(faceletPosition(CORNER_FACELETS[i][n]) == faceletPosition(CORNER_FACELETS[i][0]))) {
+                    return false;
+                }
+            }
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            if (!(faceletPosition(EDGE_FACELETS[i][1]) == faceletPosition(EDGE_FACELETS[i][0]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool twistRoundTrip() {
+        CubieCube c = solvedCubie();
+        setTwist(c, 1234);
+        return getTwist(c) == 1234;
+    }
+
+    constexpr bool sliceRoundTrip() {
+        for (int slice = 0; slice < SLICE_COUNT; slice += 13) {
+            CubieCube c = solvedCubie();
+            setSlice(c, slice);
+            if (getSlice(c) != slice) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool permutationRoundTrip() {
+        uint8_t values[8] = {};
+        setPermutation(values, 8, 31337, 0);
+        return permutationIndex(values, 8) == 31337;
+    }
+
+    // One twisted corner, two swapped corners and a corner appearing twice
+    constexpr bool unreachableCubesRejected() {
+        CubieCube twisted = solvedCubie(), swapped = solvedCubie(), repeated = solvedCubie();
+        twisted.co[CORNER_URF] = 1;
+        swapped.cp[CORNER_URF] = CORNER_UFL;
+        swapped.cp[CORNER_UFL] = CORNER_URF;
+        repeated.cp[CORNER_URF] = CORNER_UFL;
+        return !isSolvable(twisted) && !isSolvable(swapped) && !isSolvable(repeated);
+    }
+
+    static_assert(faceletsShareCubies(), "corner/edge facelet tables match the sticker geometry");
+    // Same U and R cubie moves as Kociemba's definition
+    static_assert(corners(MOVE_CUBIES.move[0], {CORNER_UBR, CORNER_URF, CORNER_UFL, CORNER_ULB, CORNER_DFR, CORNER_DLF, CORNER_DBL, CORNER_DRB}, {0, 0, 0, 0, 0, 0, 0, 0}), "U");
+    static_assert(corners(MOVE_CUBIES.move[3], {CORNER_DFR, CORNER_UFL, CORNER_ULB, CORNER_URF, CORNER_DRB, CORNER_DLF, CORNER_DBL, CORNER_UBR}, {2, 0, 0, 1, 1, 0, 0, 2}), "R");
+    static_assert(getSlice(solvedCubie()) == 0 && getTwist(solvedCubie()) == 0 && getCornerPerm(solvedCubie()) == 0, "solved coordinates");
+    static_assert(twistRoundTrip() && sliceRoundTrip() && permutationRoundTrip(), "coordinate round trips");
+    static_assert(permutationParity(MOVE_CUBIES.move[3].cp, CORNER_COUNT) == 1 && permutationParity(MOVE_CUBIES.move[4].ep, EDGE_COUNT) == 0, "turn parities");
+    static_assert(isSolvable(MOVE_CUBIES.move[3]) && isSolvable(multiply(MOVE_CUBIES.move[5], MOVE_CUBIES.move[6])), "moves stay solvable");
+    static_assert(unreachableCubesRejected(), "unreachable cubes");
+}
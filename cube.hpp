@@ -0,0 +1,316 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Header-only 3x3x3 cube state model.
+// A state is the 54 facelets in the usual U, R, F, D, L, B order (row-major per face as seen
+// from outside, with U's top row towards B and D's top row towards F), each holding the face
+// its color belongs to. The 18 face turns are gather permutations derived at compile time from
+// the sticker geometry, so applying one is a fixed 54 byte shuffle with no allocation.
+// PackedState pads the facelets to 64 bytes so a move is four SSSE3 registers permuted with
+// precomputed pshufb masks, with a scalar table-driven fallback.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define CUBE_SSSE3 1
+#else
+#define CUBE_SSSE3 0
+#endif
+
+namespace cube {
+    enum FaceId {
+        FACE_U, FACE_R, FACE_F, FACE_D, FACE_L, FACE_B,
+        FACE_ID_COUNT
+    };
+
+    constexpr int FACELETS_PER_FACE = 9;
+    constexpr int FACELET_COUNT = FACE_ID_COUNT * FACELETS_PER_FACE;
+
+    // Face turns in U, U2, U', R, R2, R', ... order: move = face * 3 + quarter turns - 1
+    constexpr int MOVE_COUNT = 18;
+
+    inline const char *MOVE_NAMES[MOVE_COUNT] = {
+        "U", "U2", "U'", "R", "R2", "R'", "F", "F2", "F'",
+        "D", "D2", "D'", "L", "L2", "L'", "B", "B2", "B'"
+    };
+
+    constexpr int moveFace(int move) { return move / 3; }
+    constexpr int inverseMove(int move) { return move - move % 3 + (2 - move % 3); }
+
+    // Turning the same face twice in a row, or U after D (and R after L, F after B) which
+    // commute, never gives a shorter solution than the sequences kept
+    constexpr bool redundantMove(int previous, int move) {
+        return previous >= 0 && (moveFace(move) == moveFace(previous) || moveFace(move) == moveFace(previous) - 3);
+    }
+
+    struct CubeState {
+        uint8_t facelets[FACELET_COUNT];
+    };
+
+    constexpr CubeState solvedState() {
+        CubeState state{};
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            state.facelets[i] = i / FACELETS_PER_FACE;
+        }
+        return state;
+    }
+
+    /* Facelet geometry in cube space: x towards R, y towards U, z towards F */
+
+    struct Ivec3 {
+        int x = 0, y = 0, z = 0;
+
+        constexpr bool operator==(const Ivec3 &o) const { return x == o.x && y == o.y && z == o.z; }
+    };
+
+    constexpr int dot(Ivec3 a, Ivec3 b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+    constexpr Ivec3 cross(Ivec3 a, Ivec3 b) { return {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x}; }
+
+    // Outward normal and the directions of increasing column and row of each face's 3x3 grid
+    constexpr Ivec3 FACE_NORMAL[FACE_ID_COUNT] = {{0, 1, 0}, {1, 0, 0}, {0, 0, 1}, {0, -1, 0}, {-1, 0, 0}, {0, 0, -1}};
+    constexpr Ivec3 FACE_RIGHT[FACE_ID_COUNT] = {{1, 0, 0}, {0, 0, -1}, {1, 0, 0}, {1, 0, 0}, {0, 0, 1}, {-1, 0, 0}};
+    constexpr Ivec3 FACE_DOWN[FACE_ID_COUNT] = {{0, 0, 1}, {0, -1, 0}, {0, -1, 0}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+
+    // Cubie position (each coordinate -1..1) carrying facelet i
+    constexpr Ivec3 faceletPosition(int facelet) {
+        int face = facelet / FACELETS_PER_FACE;
+        int row = facelet % FACELETS_PER_FACE / 3 - 1;
+        int col = facelet % 3 - 1;
+        Ivec3 n = FACE_NORMAL[face], r = FACE_RIGHT[face], d = FACE_DOWN[face];
+        return {n.x + col*r.x + row*d.x, n.y + col*r.y + row*d.y, n.z + col*r.z + row*d.z};
+    }
+
+    // Facelet on the cubie at position facing normal, -1 if there is none
+    constexpr int faceletAt(Ivec3 position, Ivec3 normal) {
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            if (FACE_NORMAL[face] == normal && dot(position, normal) == 1) {
+                return face * FACELETS_PER_FACE + (dot(position, FACE_DOWN[face]) + 1) * 3 + dot(position, FACE_RIGHT[face]) + 1;
+            }
+        }
+        return -1;
+    }
+
+    // Clockwise quarter turn seen from outside the face: -90 degrees about its normal
+    constexpr Ivec3 turnClockwise(Ivec3 v, Ivec3 axis) {
+        Ivec3 c = cross(axis, v);
+        int along = dot(axis, v);
+        return {axis.x*along - c.x, axis.y*along - c.y, axis.z*along - c.z};
+    }
+
+    // Gather permutations: after a move, facelet j holds what facelet perm[move][j] held before
+    struct MoveTables {
+        uint8_t perm[MOVE_COUNT][FACELET_COUNT];
+    };
+
+    constexpr MoveTables buildMoveTables() {
+        MoveTables tables{};
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            Ivec3 axis = FACE_NORMAL[face];
+            uint8_t *quarter = tables.perm[face * 3];
+
+            for (int i = 0; i < FACELET_COUNT; i++) {
+                quarter[i] = i;
+            }
+            for (int i = 0; i < FACELET_COUNT; i++) {
+                Ivec3 position = faceletPosition(i);
+                if (dot(position, axis) == 1) {
+                    int target = faceletAt(turnClockwise(position, axis), turnClockwise(FACE_NORMAL[i / FACELETS_PER_FACE], axis));
+                    quarter[target] = i;
+                }
+            }
+
+            // Half and counter-clockwise turns are the quarter turn composed with itself
+            for (int power = 1; power < 3; power++) {
+                for (int i = 0; i < FACELET_COUNT; i++) {
+                    tables.perm[face * 3 + power][i] = tables.perm[face * 3 + power - 1][quarter[i]];
+                }
+            }
+        }
+        return tables;
+    }
+
+    inline constexpr MoveTables MOVE_TABLES = buildMoveTables();
+
+    inline void applyMove(CubeState &state, int move) {
+        const uint8_t *perm = MOVE_TABLES.perm[move];
+        uint8_t before[FACELET_COUNT];
+        memcpy(before, state.facelets, FACELET_COUNT);
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            state.facelets[i] = before[perm[i]];
+        }
+    }
+
+    inline bool isSolved(const CubeState &state) {
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            if (state.facelets[i] != i / FACELETS_PER_FACE) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Packed 64 byte states */
+
+    constexpr int PACKED_SIZE = 64;
+    constexpr int PACKED_LANES = PACKED_SIZE / 16;
+
+    // Facelets 0-53 followed by zero padding that every move leaves in place
+    struct alignas(16) PackedState {
+        uint8_t bytes[PACKED_SIZE];
+    };
+
+    inline PackedState pack(const CubeState &state) {
+        PackedState packed{};
+        memcpy(packed.bytes, state.facelets, FACELET_COUNT);
+        return packed;
+    }
+
+    inline CubeState unpack(const PackedState &packed) {
+        CubeState state;
+        memcpy(state.facelets, packed.bytes, FACELET_COUNT);
+        return state;
+    }
+
+    // pshufb only shuffles within 16 byte lanes, so output lane k of a move is the OR of every
+    // source lane j shuffled with a mask that selects the bytes coming from lane j and zeroes
+    // the rest (high bit set)
+    struct alignas(16) ShuffleTables {
+        uint8_t lane[MOVE_COUNT][PACKED_LANES][PACKED_LANES][16];
+    };
+
+    constexpr ShuffleTables buildShuffleTables() {
+        ShuffleTables tables{};
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            for (int i = 0; i < PACKED_SIZE; i++) {
+                int source = i < FACELET_COUNT ? MOVE_TABLES.perm[move][i] : i; // padding maps to itself
+                for (int lane = 0; lane < PACKED_LANES; lane++) {
+                    tables.lane[move][i / 16][lane][i % 16] = source / 16 == lane ? source % 16 : 0x80;
+                }
+            }
+        }
+        return tables;
+    }
+
+    inline constexpr ShuffleTables SHUFFLE_TABLES = buildShuffleTables();
+
+    inline void applyMove(PackedState &state, int move) {
+#if CUBE_SSSE3
+        const __m128i (*masks)[PACKED_LANES] = reinterpret_cast<const __m128i (*)[PACKED_LANES]>(SHUFFLE_TABLES.lane[move]);
+        __m128i *lanes = reinterpret_cast<__m128i *>(state.bytes);
+        __m128i in[PACKED_LANES];
+        for (int j = 0; j < PACKED_LANES; j++) {
+            in[j] = _mm_load_si128(&lanes[j]);
+        }
+        for (int k = 0; k < PACKED_LANES; k++) {
+            __m128i out = _mm_or_si128(_mm_shuffle_epi8(in[0], _mm_load_si128(&masks[k][0])), _mm_shuffle_epi8(in[1], _mm_load_si128(&masks[k][1])));
+            out = _mm_or_si128(out, _mm_or_si128(_mm_shuffle_epi8(in[2], _mm_load_si128(&masks[k][2])), _mm_shuffle_epi8(in[3], _mm_load_si128(&masks[k][3]))));
+            _mm_store_si128(&lanes[k], out);
+        }
+#else
+        // Without pshufb the plain 54 byte tables; the padding is never touched
+        const uint8_t *perm = MOVE_TABLES.perm[move];
+        uint8_t before[FACELET_COUNT];
+        memcpy(before, state.bytes, FACELET_COUNT);
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            state.bytes[i] = before[perm[i]];
+        }
+#endif
+    }
+
+    // Same move on many states; the masks are loaded once for the whole batch
+    inline void applyMoveBatch(PackedState *states, size_t count, int move) {
+#if CUBE_SSSE3
+        const __m128i (*lanesMasks)[PACKED_LANES] = reinterpret_cast<const __m128i (*)[PACKED_LANES]>(SHUFFLE_TABLES.lane[move]);
+        __m128i masks[PACKED_LANES][PACKED_LANES];
+        for (int k = 0; k < PACKED_LANES; k++) {
+            for (int j = 0; j < PACKED_LANES; j++) {
+                masks[k][j] = _mm_load_si128(&lanesMasks[k][j]);
+            }
+        }
+
+        for (size_t n = 0; n < count; n++) {
+            __m128i *lanes = reinterpret_cast<__m128i *>(states[n].bytes);
+            __m128i in0 = _mm_load_si128(&lanes[0]);
+            __m128i in1 = _mm_load_si128(&lanes[1]);
+            __m128i in2 = _mm_load_si128(&lanes[2]);
+            __m128i in3 = _mm_load_si128(&lanes[3]);
+            for (int k = 0; k < PACKED_LANES; k++) {
+                __m128i out = _mm_or_si128(_mm_shuffle_epi8(in0, masks[k][0]), _mm_shuffle_epi8(in1, masks[k][1]));
+                out = _mm_or_si128(out, _mm_or_si128(_mm_shuffle_epi8(in2, masks[k][2]), _mm_shuffle_epi8(in3, masks[k][3])));
+                _mm_store_si128(&lanes[k], out);
+            }
+        }
+#else
+        for (size_t n = 0; n < count; n++) {
+            applyMove(states[n], move);
+        }
+#endif
+    }
+
+    /* Compile-time checks */
+
+    constexpr bool permutationsMatch(const uint8_t *a, const uint8_t *b) {
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            if (a[i] != b[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool quarterTurnHasOrderFour(int face) {
+        uint8_t power[FACELET_COUNT] = {};
+        const uint8_t *quarter = MOVE_TABLES.perm[face * 3];
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            power[i] = quarter[quarter[quarter[quarter[i]]]];
+        }
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            if (power[i] != i) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool movesFixCenters() {
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            for (int face = 0; face < FACE_ID_COUNT; face++) {
+                int center = face * FACELETS_PER_FACE + 4;
+                if (MOVE_TABLES.perm[move][center] != center) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static_assert(faceletAt(faceletPosition(17), FACE_NORMAL[FACE_R]) == 17, "facelet geometry round trip");
+    static_assert(quarterTurnHasOrderFour(FACE_U) && quarterTurnHasOrderFour(FACE_R) && quarterTurnHasOrderFour(FACE_F) &&
+                  quarterTurnHasOrderFour(FACE_D) && quarterTurnHasOrderFour(FACE_L) && quarterTurnHasOrderFour(FACE_B), "X4 = identity");
+    static_assert(movesFixCenters(), "face turns keep the centers in place");
+    // U moves the front row of F to L: F1 ends up on L1
+    static_assert(MOVE_TABLES.perm[0][4 * FACELETS_PER_FACE + 0] == 2 * FACELETS_PER_FACE + 0, "U cycles F -> L");
+    // R moves the right column of F up: U3 receives F3
+    static_assert(MOVE_TABLES.perm[3][0 * FACELETS_PER_FACE + 2] == 2 * FACELETS_PER_FACE + 2, "R cycles F -> U");
+    static_assert(sizeof(PackedState) == PACKED_SIZE, "packed states are four SSE registers");
+    static_assert(SHUFFLE_TABLES.lane[0][3][3][6] == 6 && SHUFFLE_TABLES.lane[0][3][0][6] == 0x80, "padding stays in place");
+    static_assert(inverseMove(0) == 2 && inverseMove(4) == 4 && inverseMove(17) == 15, "inverse moves");
+}
@@ -0,0 +1,161 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Depth tables: the distance of every entry of a state space from the solved entry, 4 bits per
+// entry packed 16 to a 64 bit word, generated by a parallel breadth first search that works in
+// the table itself. Used for the two-phase pruning tables and the optimal pattern databases.
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "parallel.hpp"
+
+namespace cube {
+    constexpr uint8_t PRUNE_EMPTY = 0xF; // not reached, so at least 15 moves away
+    constexpr int PRUNE_MAX_DEPTH = 14;
+
+    constexpr uint64_t NIBBLE_ONES = 0x1111111111111111ull;
+
+    // A layer is searched backward once its frontier reaches this fraction of the empty entries
+    constexpr double BACKWARD_FRONTIER_RATIO = 0.5;
+
+    inline int pruneDepth(const uint8_t *table, uint32_t index) {
+        return (table[index >> 1] >> ((index & 1) * 4)) & 0xF;
+    }
+
+    // Nonzero if any nibble of the word holds value (the classic zero byte test on nibbles)
+    constexpr uint64_t hasNibble(uint64_t word, uint64_t value) {
+        uint64_t x = word ^ (value * NIBBLE_ONES);
+        return (x - NIBBLE_ONES) & ~x & (NIBBLE_ONES * 8);
+    }
+
+    inline int loadDepth(const uint64_t *words, uint32_t index) {
+        return static_cast<int>(__atomic_load_n(&words[index >> 4], __ATOMIC_RELAXED) >> ((index & 15) * 4) & 0xF);
+    }
+
+    // Stores depth into an empty entry; false if another thread got there first
+    inline bool claimEntry(uint64_t *words, uint32_t index, uint64_t depth) {
+        uint64_t *word = &words[index >> 4];
+        int shift = (index & 15) * 4;
+        uint64_t current = __atomic_load_n(word, __ATOMIC_RELAXED);
+        while ((current >> shift & 0xF) == PRUNE_EMPTY) {
+            if (__atomic_compare_exchange_n(word, &current, current ^ ((PRUNE_EMPTY ^ depth) << shift), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct DepthTableStats {
+        double seconds = 0.0;
+        uint64_t states = 0; // entries reached
+        int depth = 0;       // deepest entry
+        uint64_t layerStates[PRUNE_EMPTY] = {};
+        double layerSeconds[PRUNE_EMPTY] = {};
+        bool backward[PRUNE_EMPTY] = {};
+    };
+
+    // Breadth first from the solved entry, one depth layer per parallel pass over the words.
+    // expand(index, visit) calls visit(neighbor) for the neighbors of an entry and stops as soon as
+    // visit returns true; the neighbor relation has to be symmetric, as it is for move sets closed
+    // under inverses. While the frontier is small a layer is searched forward: entries at the
+    // current depth claim their empty neighbors by compare-and-swap on the neighbor's word, since
+    // any thread may be writing it. Once the frontier is large, most of its neighbors are already
+    // set and it is cheaper to search backward: each empty entry looks for a neighbor at the
+    // current depth and stops at the first one. Threads then own whole words and store them
+    // plainly. Other threads' words are read with relaxed atomics either way, and only ever gain
+    // entries one deeper than the depth being looked for.
+    template <typename Expand>
+    void generateDepthTable(uint64_t *words, uint32_t entries, uint32_t solved, Expand expand, int threads, DepthTableStats *stats = nullptr) {
+        std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+        uint32_t wordCount = (entries + 15) / 16;
+        std::fill(words, words + wordCount, ~0ull);
+        words[solved >> 4] ^= static_cast<uint64_t>(PRUNE_EMPTY) << ((solved & 15) * 4);
+
+        DepthTableStats table;
+        table.layerStates[0] = 1;
+        uint64_t frontier = 1;
+        uint64_t empty = entries - 1;
+        for (int depth = 0; depth < PRUNE_MAX_DEPTH && frontier && empty; depth++) {
+            std::chrono::time_point<std::chrono::steady_clock> layerStart = std::chrono::steady_clock::now();
+            bool backward = frontier >= empty * BACKWARD_FRONTIER_RATIO;
+            std::atomic<uint64_t> reached(0);
+
+            parallel::parallelFor(0, wordCount, [&](size_t w) {
+                uint64_t word = __atomic_load_n(&words[w], __ATOMIC_RELAXED);
+                uint32_t found = 0;
+                if (backward) {
+                    if (!hasNibble(word, PRUNE_EMPTY)) {
+                        return;
+                    }
+                    uint64_t updated = word;
+                    for (uint32_t k = 0; k < 16 && w * 16 + k < entries; k++) {
+                        if ((word >> (k * 4) & 0xF) != PRUNE_EMPTY) {
+                            continue;
+                        }
+                        bool hit = false;
+                        expand(static_cast<uint32_t>(w * 16 + k), [&](uint32_t neighbor) {
+                            hit = loadDepth(words, neighbor) == depth;
+                            return hit;
+                        });
+                        if (hit) {
+                            updated ^= static_cast<uint64_t>(PRUNE_EMPTY ^ (depth + 1)) << (k * 4);
+                            found++;
+                        }
+                    }
+                    if (found) {
+                        __atomic_store_n(&words[w], updated, __ATOMIC_RELAXED);
+                    }
+                } else {
+                    if (!hasNibble(word, depth)) {
+                        return;
+                    }
+                    for (uint32_t k = 0; k < 16 && w * 16 + k < entries; k++) {
+                        if ((word >> (k * 4) & 0xF) != static_cast<uint64_t>(depth)) {
+                            continue;
+                        }
+                        expand(static_cast<uint32_t>(w * 16 + k), [&](uint32_t neighbor) {
+                            found += claimEntry(words, neighbor, depth + 1);
+                            return false;
+                        });
+                    }
+                }
+                if (found) {
+                    reached.fetch_add(found, std::memory_order_relaxed);
+                }
+            }, threads);
+
+            frontier = reached.load();
+            empty -= frontier;
+            table.backward[depth] = backward;
+            table.layerSeconds[depth] = std::chrono::duration<double>(std::chrono::steady_clock::now() - layerStart).count();
+            table.layerStates[depth + 1] = frontier;
+            table.depth = frontier ? depth + 1 : depth;
+        }
+
+        if (stats) {
+            table.states = entries - empty;
+            table.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            *stats = table;
+        }
+    }
+
+    static_assert(hasNibble(0xFFFFFFFFFFFFF3FFull, 3) && !hasNibble(0xFFFFFFFFFFFFFFFFull, 3) && hasNibble(0x0123456789ABCDEFull, 0xF), "nibble test");
+}
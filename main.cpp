@@ -16,20 +16,36 @@
 
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <signal.h>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <memory>
 
 #include <math.h>
 #include <vector>
 #include <numeric>
+#include <algorithm>
 #include <string>
-
-struct Vector3f {
-    float x, y, z;
-};
+#include <random>
+
+#include "vecmath.hpp"
+#include "cube.hpp"
+#include "coord.hpp"
+#include "twophase.hpp"
+#include "optimal.hpp"
+#include "nxn.hpp"
+#include "notation.hpp"
+#include "perft.hpp"
+#include "pocket.hpp"
+
+using vecmath::Vec3;
+using vecmath::Mat3;
+using vecmath::Mat4;
+using vecmath::Quat;
 
 struct Dim2i {
     int w, h;
@@ -78,15 +94,160 @@ namespace ANSI_escape_code {
     }
 }
 
+// Colors the rasterizer writes, stored per pixel as an index so each output mode can pick its
+// own encoding. Regular and bold entries follow the ANSI color order (black, red, ..., white).
+enum Color : uint8_t {
+    COLOR_DEFAULT,
+    COLOR_BLACK, COLOR_RED, COLOR_GREEN, COLOR_YELLOW, COLOR_BLUE, COLOR_MAGENTA, COLOR_CYAN, COLOR_WHITE,
+    COLOR_BOLD_BLACK, COLOR_BOLD_RED, COLOR_BOLD_GREEN, COLOR_BOLD_YELLOW, COLOR_BOLD_BLUE, COLOR_BOLD_MAGENTA, COLOR_BOLD_CYAN, COLOR_BOLD_WHITE,
+    COLOR_COUNT
+};
+
+const char *COLOR_SGR[COLOR_COUNT] = {
+    ANSI_escape_code::color::RESET,
+    ANSI_escape_code::color::BLACK, ANSI_escape_code::color::RED, ANSI_escape_code::color::GREEN, ANSI_escape_code::color::YELLOW,
+    ANSI_escape_code::color::BLUE, ANSI_escape_code::color::MAGENTA, ANSI_escape_code::color::CYAN, ANSI_escape_code::color::WHITE,
+    ANSI_escape_code::color::BOLD_BLACK, ANSI_escape_code::color::BOLD_RED, ANSI_escape_code::color::BOLD_GREEN, ANSI_escape_code::color::BOLD_YELLOW,
+    ANSI_escape_code::color::BOLD_BLUE, ANSI_escape_code::color::BOLD_MAGENTA, ANSI_escape_code::color::BOLD_CYAN, ANSI_escape_code::color::BOLD_WHITE
+};
+
+// SGR foreground parameter (30-37, bright 90-97, default 39); add 10 for the background
+int colorSgrParam(uint8_t color) {
+    if (color == COLOR_DEFAULT) {
+        return 39;
+    }
+    return color < COLOR_BOLD_BLACK ? 30 + (color - COLOR_BLACK) : 90 + (color - COLOR_BOLD_BLACK);
+}
+
+// The 16 named colors, or every color shaded by the face luminance on the 6x6x6 cube of the
+// 256 color palette or in 24-bit RGB
+enum ColorMode {
+    COLOR_MODE_16,
+    COLOR_MODE_256,
+    COLOR_MODE_TRUECOLOR
+};
+
+ColorMode colorMode = COLOR_MODE_16;
+
+// Raster colors are indices color + COLOR_COUNT * shade, one shade per luminance ramp glyph.
+// In the 16 color mode the shade is always 0.
+const int SHADE_LEVELS = 12;
+const int SHADED_COLOR_COUNT = COLOR_COUNT * SHADE_LEVELS;
+static_assert(SHADED_COLOR_COUNT <= 256, "shaded colors must fit the uint8_t color buffer");
+
+// Base RGB of each color for the 256 color and truecolor modes. BOLD_RED is the 16 color
+// palette's stand-in for the orange face.
+const uint8_t COLOR_RGB[COLOR_COUNT][3] = {
+    {0, 0, 0},
+    {0, 0, 0}, {183, 18, 52}, {0, 155, 72}, {255, 213, 0}, {0, 70, 173}, {170, 0, 170}, {0, 170, 170}, {230, 230, 230},
+    {85, 85, 85}, {255, 88, 0}, {85, 255, 85}, {255, 255, 85}, {85, 85, 255}, {255, 85, 255}, {85, 255, 255}, {255, 255, 255}
+};
+
+// Pre-encoded SGR parameters ("38;5;208") for every shaded color, packed back to back so the
+// encoders copy spans instead of formatting, and can still join fg and bg in one sequence
+struct SgrTable {
+    std::string bytes;
+    uint16_t offset[SHADED_COLOR_COUNT];
+    uint8_t length[SHADED_COLOR_COUNT];
+};
+
+SgrTable sgrForeground, sgrBackground;
+
+void appendSgrParams(std::string &out, const SgrTable &table, uint8_t color) {
+    out.append(table.bytes.data() + table.offset[color], table.length[color]);
+}
+
+// Encodes one color in the given mode; background parameters are the foreground ones + 10
+std::string encodeSgrParams(ColorMode mode, uint8_t color, int shade, bool background) {
+    int base = background ? 10 : 0;
+    char params[32];
+
+    if (mode == COLOR_MODE_16 || color == COLOR_DEFAULT) {
+        snprintf(params, sizeof(params), "%d", colorSgrParam(color) + base);
+        return params;
+    }
+
+    // Ambient floor so faces turned away from the light stay recognizable
+    float intensity = 0.25f + 0.75f * shade / (SHADE_LEVELS - 1);
+    int rgb[3];
+    for (int c = 0; c < 3; c++) {
+        rgb[c] = static_cast<int>(COLOR_RGB[color][c] * intensity + 0.5f);
+    }
+
+    if (mode == COLOR_MODE_256) {
+        int cube = 16 + 36 * ((rgb[0] * 5 + 127) / 255) + 6 * ((rgb[1] * 5 + 127) / 255) + ((rgb[2] * 5 + 127) / 255);
+        snprintf(params, sizeof(params), "%d;5;%d", 38 + base, cube);
+    } else {
+        snprintf(params, sizeof(params), "%d;2;%d;%d;%d", 38 + base, rgb[0], rgb[1], rgb[2]);
+    }
+    return params;
+}
+
+// Built once at startup. The ASCII mode resets before every cell, so its 16 color foregrounds
+// keep the bold parameters of COLOR_SGR; the state-tracking encoders need bright colors that
+// don't leave an attribute behind.
+void buildSgrTables(ColorMode mode, bool resetPerCell) {
+    sgrForeground.bytes.clear();
+    sgrBackground.bytes.clear();
+
+    for (int index = 0; index < SHADED_COLOR_COUNT; index++) {
+        uint8_t color = index % COLOR_COUNT;
+        int shade = mode == COLOR_MODE_16 ? 0 : index / COLOR_COUNT;
+
+        std::string foreground = encodeSgrParams(mode, color, shade, false);
+        if (mode == COLOR_MODE_16 && resetPerCell) {
+            // Strip the leading ESC [ and the trailing m
+            foreground.assign(COLOR_SGR[color] + 2, strlen(COLOR_SGR[color]) - 3);
+        }
+        std::string background = encodeSgrParams(mode, color, shade, true);
+
+        sgrForeground.offset[index] = sgrForeground.bytes.size();
+        sgrForeground.length[index] = foreground.size();
+        sgrForeground.bytes += foreground;
+
+        sgrBackground.offset[index] = sgrBackground.bytes.size();
+        sgrBackground.length[index] = background.size();
+        sgrBackground.bytes += background;
+    }
+}
+
+// Braille cells are 2x4 dots; U+2800 + mask sets dot n for bit n-1 in this order
+const uint8_t BRAILLE_DOT_BITS[4][2] = {
+    {0x01, 0x08},
+    {0x02, 0x10},
+    {0x04, 0x20},
+    {0x40, 0x80}
+};
+
+// UTF-8 encoding of U+2800 + mask for every dot mask
+struct BrailleGlyphs {
+    char bytes[256][3];
+};
+
+constexpr BrailleGlyphs makeBrailleGlyphs() {
+    BrailleGlyphs glyphs{};
+    for (int mask = 0; mask < 256; mask++) {
+        glyphs.bytes[mask][0] = static_cast<char>(0xE2);
+        glyphs.bytes[mask][1] = static_cast<char>(0xA0 | (mask >> 6));
+        glyphs.bytes[mask][2] = static_cast<char>(0x80 | (mask & 0x3F));
+    }
+    return glyphs;
+}
+
+constexpr BrailleGlyphs BRAILLE_GLYPHS = makeBrailleGlyphs();
+
+static_assert(BRAILLE_GLYPHS.bytes[0x00][1] == '\xA0' && BRAILLE_GLYPHS.bytes[0x00][2] == '\x80', "U+2800");
+static_assert(BRAILLE_GLYPHS.bytes[0xFF][1] == '\xA3' && BRAILLE_GLYPHS.bytes[0xFF][2] == '\xBF', "U+28FF");
+
 class Timer {
     private:
         std::chrono::time_point<std::chrono::steady_clock> start, end;
         std::chrono::duration<int, std::micro> duration;
         std::vector<int> *durationVector;
     public:
-        Timer(std::vector<int> *_durationVector = nullptr) : start(std::chrono::high_resolution_clock::now()), durationVector(_durationVector) {}
+        Timer(std::vector<int> *_durationVector = nullptr) : start(std::chrono::steady_clock::now()), durationVector(_durationVector) {}
         ~Timer() {
-            end = std::chrono::high_resolution_clock::now();
+            end = std::chrono::steady_clock::now();
             duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
             if (durationVector != nullptr) {
@@ -105,40 +266,256 @@ class Timer {
         }
 };
 
+// Records the duration of a pipeline stage in nanoseconds without printing anything
+class StageTimer {
+    private:
+        std::chrono::time_point<std::chrono::steady_clock> start;
+        std::vector<int> *durationVector;
+    public:
+        StageTimer(std::vector<int> *_durationVector) : start(std::chrono::steady_clock::now()), durationVector(_durationVector) {}
+        ~StageTimer() {
+            durationVector->push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+};
+
 #define PROFILING 1
 #if PROFILING
 #define PROFILE_SCOPE(durationVector) Timer timer##__LINE__(&durationVector)
+#define PROFILE_STAGE(durationVector) StageTimer stageTimer##__LINE__(&durationVector)
+#define COUNT_FRAGMENTS(counter) rasterStats.counter++
 #else
 #define PROFILE_SCOPE(durationVector)
+#define PROFILE_STAGE(durationVector)
+#define COUNT_FRAGMENTS(counter)
 #endif
 
+// ASCII shades with the luminance ramp, half-block splits every cell into two colored pixels
+// and braille into 2x4 dots sharing one color
+enum RenderMode {
+    RENDER_ASCII,
+    RENDER_HALF_BLOCK,
+    RENDER_BRAILLE
+};
+
 bool showDebugInfo = true;
+bool showOverdrawHeatmap = false;
+int antialiasSamples = 0; // subsamples per edge cell axis (2 or 4), 0 = off
+int scrambleMoves = 0; // random face turns applied to the displayed cube at startup
+bool scrambleRandomState = false; // start from a uniformly random state instead (2x2x2 and 3x3x3 only)
+const char *scrambleNotation = nullptr; // or replay these moves, in WCA notation
+bool solveLoop = false; // keep scrambling the displayed cube and playing back its solution
+bool solveOptimally = false; // solve loop uses the optimal solver instead of two-phase
+int cubeSize = 3; // stickers along a face edge, cube::NXN_MIN_SIZE to cube::NXN_MAX_SIZE
+RenderMode renderMode = RENDER_ASCII;
 
 int WIDTH = 50;
 int HEIGHT = 25;
 
-std::vector<char> buffer((WIDTH * HEIGHT), ' ');
-std::vector<char> buffer_prev((WIDTH * HEIGHT), ' ');
-std::vector<std::string_view> cbuffer((WIDTH * HEIGHT), ANSI_escape_code::color::RESET);
-std::vector<std::string_view> cbuffer_prev((WIDTH * HEIGHT), ANSI_escape_code::color::RESET);
-std::vector<float> zbuffer((WIDTH * HEIGHT), 0);
+// Raster pixels per terminal cell and the resulting raster size. The depth and overdraw buffers
+// are always allocated at raster size; the braille mode keeps its glyph and color buffers per
+// cell, with the glyph buffer holding the dot mask.
+Dim2i rasterScale = {1, 1};
+int RASTER_WIDTH = WIDTH;
+int RASTER_HEIGHT = HEIGHT;
+
+std::vector<char> buffer((RASTER_WIDTH * RASTER_HEIGHT), ' ');
+std::vector<char> buffer_prev((RASTER_WIDTH * RASTER_HEIGHT), ' ');
+std::vector<uint8_t> cbuffer((RASTER_WIDTH * RASTER_HEIGHT), COLOR_DEFAULT);
+std::vector<uint8_t> cbuffer_prev((RASTER_WIDTH * RASTER_HEIGHT), COLOR_DEFAULT);
+std::vector<float> zbuffer((RASTER_WIDTH * RASTER_HEIGHT), 0);
+std::vector<uint16_t> overdrawBuffer((RASTER_WIDTH * RASTER_HEIGHT), 0);
+
+// Encoded escape sequences for one frame, written with a single fwrite
+std::string frameOutput;
+
+struct OutputStats {
+    uint64_t bytes = 0;
+    uint64_t cellsUpdated = 0;
+    uint32_t frames = 0;
+};
+
+OutputStats outputStats;
 
 const float CUBE_SIZE = 1.0f; // Unit Cube
 float SPACING = 3.0f / WIDTH;
 const float GRID_SPACING = 0.04f;
-const char *GRID_LINE_COLOR = ANSI_escape_code::color::BLACK;
+const uint8_t GRID_LINE_COLOR = COLOR_BLACK;
+
+// Sticker classification per lattice sample: bits 0-6 hold the sticker index (0 to cubeSize^2 - 1,
+// row-major over the outer/inner loop axes) and bit 7 is set when the sample lies on a grid line
+const uint8_t STICKER_INDEX_MASK = 0x7F;
+const uint8_t STICKER_GRID_LINE = 0x80;
+
+// Samples along one face axis for a given sample count. The outer/inner sticker codes are
+// pre-scaled so a sample's classification is (outer + inner) for the index and (outer | inner)
+// for the grid line bit.
+struct AxisLattice {
+    std::vector<float> coord;
+    std::vector<uint8_t> outerSticker;
+    std::vector<uint8_t> innerSticker;
+};
+
+// Per-axis lattices for every sample count up to maxSamplesPerAxis, rebuilt only on resize.
+// Each face picks its own outer/inner counts per frame from its projected size.
+struct FaceLattice {
+    int maxSamplesPerAxis = 0;
+    int fixedSamplesPerAxis = 0; // count the old fixed SPACING lattice would use
+    std::vector<AxisLattice> axes; // indexed by sample count
+    int buildTime = 0; // microseconds
+
+    size_t memoryBytes() const {
+        size_t bytes = axes.capacity() * sizeof(AxisLattice);
+        for (const AxisLattice &axis : axes) {
+            bytes += axis.coord.capacity() * sizeof(float) + axis.outerSticker.capacity() + axis.innerSticker.capacity();
+        }
+        return bytes;
+    }
+};
+
+FaceLattice faceLattice;
+
+// Scratch row streamed through the batch transform: constant outer/fixed coordinates in,
+// camera-space points out. Sized to the longest lattice axis.
+struct SampleRow {
+    std::vector<float> outer, fixed;
+    std::vector<float> x, y, z;
+
+    void resize(size_t n) {
+        outer.resize(n);
+        fixed.resize(n);
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+    }
+};
+
+SampleRow sampleRow;
+
+// Target lattice samples per screen cell along each projected face edge
+const float SAMPLES_PER_CELL = 1.25f;
+
+// Fragment accounting for the raster path, accumulated over the whole run.
+// Overdraw is in-bounds fragments per distinct covered cell.
+struct RasterStats {
+    uint64_t fragmentsGenerated = 0;
+    uint64_t fragmentsOutOfBounds = 0;
+    uint64_t fragmentsDepthRejected = 0;
+    uint64_t fragmentsWritten = 0;
+    uint64_t cellsCovered = 0;
+    uint32_t frames = 0;
+
+    float overdraw() const {
+        return cellsCovered ? static_cast<float>(fragmentsGenerated - fragmentsOutOfBounds) / cellsCovered : 0.0f;
+    }
+};
+
+RasterStats rasterStats;
+
+// Cells crossed by a projected face edge this frame. The mask is cleared through the list so
+// the antialiasing pass stays proportional to edge length.
+struct EdgeCells {
+    std::vector<uint8_t> mask;
+    std::vector<int> cells;
+    uint64_t total = 0; // over the whole run
+};
+
+EdgeCells edgeCells;
 
 const float K2 = 10.0f;
 float K1 = (WIDTH * K2 * 3) / (8 * (sqrt(3)*CUBE_SIZE));
 
-Vector3f lightSource = {0.0f, 1.0f, -1.0f};
-Vector3f rotatedLightSource = {0.0f, 1.0f, -1.0f};
-std::vector<float> trigValues(6);
+// Faces in render order: axis A (z), axis B (y), axis C (x)
+enum Face {
+    FACE_A_FRONT, FACE_A_BACK,
+    FACE_B_FRONT, FACE_B_BACK,
+    FACE_C_FRONT, FACE_C_BACK,
+    FACE_COUNT
+};
+
+const Vec3 FACE_NORMALS[FACE_COUNT] = {
+    {0.0f, 0.0f, CUBE_SIZE}, {0.0f, 0.0f, -CUBE_SIZE},
+    {0.0f, CUBE_SIZE, 0.0f}, {0.0f, -CUBE_SIZE, 0.0f},
+    {CUBE_SIZE, 0.0f, 0.0f}, {-CUBE_SIZE, 0.0f, 0.0f}
+};
+
+const uint8_t FACE_COLORS[FACE_COUNT] = {
+    COLOR_YELLOW, COLOR_WHITE,
+    COLOR_GREEN, COLOR_BLUE,
+    COLOR_BOLD_RED, COLOR_RED
+};
+
+const char *LUMINANCE_RAMP = ".,-~:;=!*#$@";
+
+// Cube space axes of each face pair as (outer, inner, fixed), matching renderCubeAxis_*
+const int FACE_AXES[FACE_COUNT / 2][3] = {{1, 0, 2}, {0, 2, 1}, {2, 1, 0}};
+
+// Output of the per-frame lighting stage; the raster loop only reads the glyph and sticker palette
+struct FaceShading {
+    float luminance;
+    char glyph;
+    uint8_t shadeOffset; // added to the sticker colors outside the 16 color mode
+};
+
+FaceShading faceShading[FACE_COUNT];
+FaceShading turnShading[FACE_COUNT]; // faces of the turning layer, lit at their turned angle
+
+// Cube state shown by the renderer, facelets hold the cube::FaceId whose color they carry
+cube::NxnPuzzle puzzle;
+cube::NxnState cubeState;
+
+// Sticker color per cube face, taken from the render face the solved face is drawn on
+uint8_t cubeFaceColors[cube::FACE_ID_COUNT];
+
+// Facelet drawn by each sticker index of each render face
+uint16_t faceStickerFacelets[FACE_COUNT][cube::NXN_MAX_SIZE * cube::NXN_MAX_SIZE];
+int centerSticker = 4; // sticker index nearest the middle of a face
+
+// Per-face color lookup indexed directly by the sticker classification byte, so a sample's
+// color is one load whether it is a sticker or a grid line
+const int STICKER_PALETTE_SIZE = STICKER_GRID_LINE + STICKER_INDEX_MASK + 1;
+uint8_t stickerPalettes[FACE_COUNT][STICKER_PALETTE_SIZE];
+uint8_t turnPalettes[FACE_COUNT][STICKER_PALETTE_SIZE];
+uint8_t interiorPalette[STICKER_PALETTE_SIZE]; // cubie interiors exposed by a layer turn
+
+// Layer turn being animated. cubeState still holds the position before the move until the
+// turn completes; the turning layer is drawn through an extra rotation about its axis.
+struct LayerTurn {
+    int move = -1; // none
+    uint32_t startFrame = 0;
+    float angle = 0.0f; // radians about the layer's outward axis in cube space
+};
+
+LayerTurn layerTurn;
+
+// Part of a face kept when the cube is split for a layer turn: the samples whose coordinate
+// along axis lies in [lo, hi)
+struct FaceClip {
+    int axis = -1; // no clipping
+    float lo = 0.0f;
+    float hi = 0.0f;
+};
+
+Vec3 lightSource = {0.0f, 1.0f, -1.0f};
+Vec3 rotatedLightSource = {0.0f, 1.0f, -1.0f};
+Mat3 rotation;
+
+// Orientations are integrated by quaternion multiplication with precomputed per-frame deltas.
+// Each frame the world delta spins the cube about the screen axis and the body delta about the
+// cube's own y and x axes, a fixed rotation composed on each side. That tumbles much like the
+// old A/B/C Euler angle steps but does not follow the same path; the angles only set the start.
+Quat cubeOrientation, cubeWorldDelta, cubeBodyDelta;
+Quat lightOrientation, lightWorldDelta, lightBodyDelta;
+bool rotateLightSource = true;
+const int RENORMALIZE_INTERVAL = 64; // frames
 
 const float FPS_LIMIT = 60.0f;
 const float FRAME_DURATION_MICRO = 1000000.0f / (FPS_LIMIT ? FPS_LIMIT : 1);
 std::chrono::time_point<std::chrono::steady_clock> nextFrame, previousFrame;
 std::vector<int> frameTimes;
+std::vector<int> lightingTimes; // nanoseconds
+std::vector<int> rasterTimes; // nanoseconds
+std::vector<int> antialiasTimes; // nanoseconds
+std::vector<int> turnRasterTimes; // nanoseconds, raster stage of the layer turn frames only
 
 static uint32_t allocCount = 0;
 void *operator new(size_t size) {
@@ -146,417 +523,2357 @@ void *operator new(size_t size) {
     return malloc(size);
 }
 
-float getVectorMag(Vector3f vec) {
-    float x = vec.x;
-    float y = vec.y;
-    float z = vec.z;
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
 
-    return sqrt(x*x + y*y + z*z);
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
 }
 
-void normVector(Vector3f &vec) {
-    float x = vec.x;
-    float y = vec.y;
-    float z = vec.z;
+// Advances an orientation by one frame: world delta on the left, body delta on the right
+void stepOrientation(Quat &orientation, Quat worldDelta, Quat bodyDelta, uint32_t frame) {
+    orientation = worldDelta * orientation * bodyDelta;
 
-    float mag = getVectorMag(vec);
-    // one over mag
-    float oomag = 1 / mag;
+    // Rounding drifts the quaternion off unit length slowly, so only renormalize occasionally
+    if (frame % RENORMALIZE_INTERVAL == 0) {
+        orientation = vecmath::normalize(orientation);
+    }
+}
 
-    if (mag > 0) {
-        // vec = {x/mag, y/mag, z/mag};
-        vec = {x * oomag, y * oomag, z * oomag};
+// Sticker boundaries, boundary[k] starting stripe k. Each is measured from the nearer cube edge
+// so the grid is symmetric, and the grid lines narrow as the stickers do.
+void stickerBoundaries(float boundary[cube::NXN_MAX_SIZE + 1]) {
+    const float stickerSize = CUBE_SIZE / cubeSize;
+    for (int k = 1; k < cubeSize; k++) {
+        boundary[k] = k * 2 <= cubeSize ? -CUBE_SIZE/2 + k * stickerSize : CUBE_SIZE/2 - (cubeSize - k) * stickerSize;
     }
 }
 
-void updateBuffers(float i, float j, float k, std::vector<float> &trigValues, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<std::string_view> &cbuffer, std::string_view color, float luminance) {
-    float sinA = trigValues[0], cosA = trigValues[1];
-    float sinB = trigValues[2], cosB = trigValues[3];
-    float sinC = trigValues[4], cosC = trigValues[5];
+// Sticker stripe of a face coordinate: a rounded estimate, corrected against the exact
+// boundaries it may straddle
+int stickerStripe(const float boundary[cube::NXN_MAX_SIZE + 1], float c) {
+    int stripe = std::clamp(static_cast<int>((c + CUBE_SIZE/2) / (CUBE_SIZE / cubeSize)), 0, cubeSize - 1);
+    while (stripe > 0 && c < boundary[stripe]) {
+        stripe--;
+    }
+    while (stripe < cubeSize - 1 && c >= boundary[stripe + 1]) {
+        stripe++;
+    }
+    return stripe;
+}
 
-    float x = cosA*cosB*j + (cosA*sinB*sinC - sinA*cosC)*i + (cosA*sinB*cosC + sinA*sinC)*k;
-    float y = sinA*cosB*j + (sinA*sinB*sinC + cosA*cosC)*i + (sinA*sinB*cosC - cosA*sinC)*k;
-    float z = -j*sinB + i*cosB*sinC + k*cosB*cosC + K2;
+void buildFaceLattice(FaceLattice &lattice) {
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+    // Longest possible projected edge is a face edge at the nearest point of the cube
+    float maxEdgeCells = K1 * std::max(rasterScale.w, rasterScale.h) * CUBE_SIZE / (K2 - CUBE_SIZE * sqrt(3) / 2);
+    lattice.maxSamplesPerAxis = static_cast<int>(ceil(maxEdgeCells * SAMPLES_PER_CELL)) + 1;
+    lattice.fixedSamplesPerAxis = static_cast<int>(CUBE_SIZE / SPACING + 1e-4f) + 1;
+    lattice.axes.resize(lattice.maxSamplesPerAxis + 1);
+
+    float boundary[cube::NXN_MAX_SIZE + 1];
+    stickerBoundaries(boundary);
+    const float gridSpacing = GRID_SPACING * (3.0f / cubeSize);
+
+    // Integer sample counts so every size gets the same coverage of [-CUBE_SIZE/2, CUBE_SIZE/2]
+    for (int n = 2; n <= lattice.maxSamplesPerAxis; n++) {
+        AxisLattice &axis = lattice.axes[n];
+        axis.coord.resize(n);
+        axis.outerSticker.resize(n);
+        axis.innerSticker.resize(n);
+
+        // A grid line at least half a sample wide on each side always catches a sample, so fine
+        // grids on small faces keep every line instead of dropping some between samples. Lines
+        // never widen past the 3x3x3 ones, which are drawn exactly as before.
+        float step = CUBE_SIZE / (n - 1);
+        float lineWidth = std::max(gridSpacing, std::min(step / 2, GRID_SPACING));
+        for (int s = 0; s < n; s++) {
+            float c = -CUBE_SIZE/2 + s * step;
+
+            int stripe = stickerStripe(boundary, c);
+
+            // Only the boundaries on either side of the stripe can be near enough
+            bool gridLine = false;
+            for (int k = std::max(stripe, 1); k <= std::min(stripe + 1, cubeSize - 1); k++) {
+                gridLine = gridLine || (c > boundary[k] - lineWidth && c < boundary[k] + lineWidth);
+            }
 
-    float ooz = 1 / z; // "One over z"
+            axis.coord[s] = c;
+            axis.outerSticker[s] = (stripe * cubeSize) | (gridLine ? STICKER_GRID_LINE : 0);
+            axis.innerSticker[s] = stripe | (gridLine ? STICKER_GRID_LINE : 0);
+        }
+    }
 
-    int xp = static_cast<int>((WIDTH/2) + (K1*ooz*x));
-    int yp = static_cast<int>((HEIGHT/2) - (K1*ooz*y));
+    sampleRow.resize(lattice.maxSamplesPerAxis);
 
-    int index = xp + yp * WIDTH;
-    std::vector<char>::size_type indexLimit = buffer.size();
+    lattice.buildTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
 
-    std::vector<char>::iterator bufferIter = buffer.begin();
-    std::vector<std::string_view>::iterator cbufferIter = cbuffer.begin();
-    std::vector<float>::iterator zbufferIter = zbuffer.begin();
+// Raster position of a point in cube space (x = j, y = i, z = k)
+void projectPoint(Vec3 p, const Mat4 &view, float &xp, float &yp) {
+    Vec3 c = vecmath::transformPoint(view, p);
 
-    // Luminance ranges from -1 to +1 for the dot product of the plane normal and light source normalized 3D unit vectors
-    // If the luminance > 0, then the plane is facing towards the light source
-    // else if luminance < 0, then the plane is facing away from the light source
-    // else if luminance = 0, then the plane and the light source are perpendicular
-    int luminance_index = luminance * 11;
-    if (index >= 0 && index < indexLimit) {
-        if (ooz > zbuffer[index]) {
-            *(zbufferIter + index) = ooz;
-            *(cbufferIter + index) = color;
-            *(bufferIter + index) = ".,-~:;=!*#$@"[luminance > 0 ? luminance_index : 0];
-        }
-    }
+    float ooz = 1 / c.z;
+    xp = (RASTER_WIDTH/2) + (K1*rasterScale.w*ooz*c.x);
+    yp = (RASTER_HEIGHT/2) - (K1*rasterScale.h*ooz*c.y);
 }
 
-void renderCubeAxis_A(std::vector<float> &trigValues, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<std::string_view> &cbuffer, std::string_view color1, std::string_view color2) {
-    float sinA = trigValues[0], cosA = trigValues[1];
-    float sinB = trigValues[2], cosB = trigValues[3];
-    float sinC = trigValues[4], cosC = trigValues[5];
+// Inverse of projectPoint onto a face plane: the cube space point where the camera ray through
+// a raster position meets p[fixedAxis] = fixed. The view is a rotation and a translation, so the
+// transposed rotation takes camera space back to cube space.
+Vec3 unprojectToFace(float xp, float yp, const Mat3 &rotation, const Mat4 &view, int fixedAxis, float fixed) {
+    Mat3 inverse = vecmath::transpose(rotation);
+    Vec3 ray = inverse * Vec3{(xp - RASTER_WIDTH/2) / (K1*rasterScale.w), -(yp - RASTER_HEIGHT/2) / (K1*rasterScale.h), 1.0f};
+    Vec3 origin = inverse * Vec3{-view.r[0].w, -view.r[1].w, -view.r[2].w};
+    float t = (fixed - origin[fixedAxis]) / ray[fixedAxis];
+    return origin + ray * t;
+}
 
-    Vector3f surfaceNormal_front = {0.0f, 0.0f, CUBE_SIZE};
-    Vector3f surfaceNormal_back = {0.0f, 0.0f, -CUBE_SIZE};
+// Picks outer/inner sample counts for a face from the screen length of its edges, measured in
+// raster pixels along the dominant direction so consecutive samples never skip a cell.
+// Corners are ordered (outer-, inner-), (outer+, inner-), (outer-, inner+), (outer+, inner+).
+void faceSampleCounts(const Vec3 corners[4], const Mat4 &view, int &outerCount, int &innerCount) {
+    float xp[4], yp[4];
+    for (int c = 0; c < 4; c++) {
+        projectPoint(corners[c], view, xp[c], yp[c]);
+    }
 
-    Vector3f rotatedSurfaceNormal_front = {
-        cosA*cosB*surfaceNormal_front.x + (cosA*sinB*sinC - sinA*cosC)*surfaceNormal_front.y + (cosA*sinB*cosC + sinA*sinC)*surfaceNormal_front.z,
-        sinA*cosB*surfaceNormal_front.x + (sinA*sinB*sinC + cosA*cosC)*surfaceNormal_front.y + (sinA*sinB*cosC - cosA*sinC)*surfaceNormal_front.z,
-        -surfaceNormal_front.x*sinB + surfaceNormal_front.y*cosB*sinC + surfaceNormal_front.z*cosB*cosC
+    auto edgeCells = [&](int a, int b) {
+        return std::max(fabsf(xp[b] - xp[a]), fabsf(yp[b] - yp[a]));
     };
-    normVector(rotatedSurfaceNormal_front);
+    float outerCells = std::max(edgeCells(0, 1), edgeCells(2, 3));
+    float innerCells = std::max(edgeCells(0, 2), edgeCells(1, 3));
 
-    Vector3f rotatedSurfaceNormal_back = {
-        cosA*cosB*surfaceNormal_back.x + (cosA*sinB*sinC - sinA*cosC)*surfaceNormal_back.y + (cosA*sinB*cosC + sinA*sinC)*surfaceNormal_back.z,
-        sinA*cosB*surfaceNormal_back.x + (sinA*sinB*sinC + cosA*cosC)*surfaceNormal_back.y + (sinA*sinB*cosC - cosA*sinC)*surfaceNormal_back.z,
-        -surfaceNormal_back.x*sinB + surfaceNormal_back.y*cosB*sinC + surfaceNormal_back.z*cosB*cosC
-    };
-    normVector(rotatedSurfaceNormal_back);
-
-    float luminance_front = rotatedSurfaceNormal_front.x*rotatedLightSource.x + rotatedSurfaceNormal_front.y*rotatedLightSource.y + rotatedSurfaceNormal_front.z*rotatedLightSource.z;
-    float luminance_back = rotatedSurfaceNormal_back.x*rotatedLightSource.x + rotatedSurfaceNormal_back.y*rotatedLightSource.y + rotatedSurfaceNormal_back.z*rotatedLightSource.z;
-
-    // z
-    float k = CUBE_SIZE/2;
-
-    // y
-    for (float i = -CUBE_SIZE/2; i <= CUBE_SIZE/2; i+=SPACING) {
-        // x
-        for (float j = -CUBE_SIZE/2; j <= CUBE_SIZE/2; j+=SPACING) {
-            std::string_view charColor1 = color1;
-            std::string_view charColor2 = color2;
-            if (i > (-CUBE_SIZE/2 + CUBE_SIZE/3) - GRID_SPACING &&
-                    i < (-CUBE_SIZE/2 + CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (i > (CUBE_SIZE/2 - CUBE_SIZE/3) - GRID_SPACING &&
-                    i < (CUBE_SIZE/2 - CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (j > (-CUBE_SIZE/2 + CUBE_SIZE/3) - GRID_SPACING &&
-                    j < (-CUBE_SIZE/2 + CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (j > (CUBE_SIZE/2 - CUBE_SIZE/3) - GRID_SPACING &&
-                    j < (CUBE_SIZE/2 - CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            }
-
-            /* Front Face */
-            updateBuffers(i, j, k, trigValues, buffer, zbuffer, cbuffer, charColor1, luminance_front);
-
-            /* Back Face */
-            updateBuffers(i, j, -k, trigValues, buffer, zbuffer, cbuffer, charColor2, luminance_back);
-        }
-    }
-}
-
-void renderCubeAxis_B(std::vector<float> &trigValues, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<std::string_view> &cbuffer, std::string_view color1, std::string_view color2) {
-    float sinA = trigValues[0], cosA = trigValues[1];
-    float sinB = trigValues[2], cosB = trigValues[3];
-    float sinC = trigValues[4], cosC = trigValues[5];
-
-    Vector3f surfaceNormal_front = {0.0f, CUBE_SIZE, 0.0f};
-    Vector3f surfaceNormal_back = {0.0f, -CUBE_SIZE, 0.0f};
-
-    Vector3f rotatedSurfaceNormal_front = {
-        cosA*cosB*surfaceNormal_front.x + (cosA*sinB*sinC - sinA*cosC)*surfaceNormal_front.y + (cosA*sinB*cosC + sinA*sinC)*surfaceNormal_front.z,
-        sinA*cosB*surfaceNormal_front.x + (sinA*sinB*sinC + cosA*cosC)*surfaceNormal_front.y + (sinA*sinB*cosC - cosA*sinC)*surfaceNormal_front.z,
-        -surfaceNormal_front.x*sinB + surfaceNormal_front.y*cosB*sinC + surfaceNormal_front.z*cosB*cosC
-    };
-    normVector(rotatedSurfaceNormal_front);
+    outerCount = std::clamp(static_cast<int>(ceil(outerCells * SAMPLES_PER_CELL)) + 1, 2, faceLattice.maxSamplesPerAxis);
+    innerCount = std::clamp(static_cast<int>(ceil(innerCells * SAMPLES_PER_CELL)) + 1, 2, faceLattice.maxSamplesPerAxis);
+}
 
-    Vector3f rotatedSurfaceNormal_back = {
-        cosA*cosB*surfaceNormal_back.x + (cosA*sinB*sinC - sinA*cosC)*surfaceNormal_back.y + (cosA*sinB*cosC + sinA*sinC)*surfaceNormal_back.z,
-        sinA*cosB*surfaceNormal_back.x + (sinA*sinB*sinC + cosA*cosC)*surfaceNormal_back.y + (sinA*sinB*cosC - cosA*sinC)*surfaceNormal_back.z,
-        -surfaceNormal_back.x*sinB + surfaceNormal_back.y*cosB*sinC + surfaceNormal_back.z*cosB*cosC
-    };
-    normVector(rotatedSurfaceNormal_back);
-
-    float luminance_front = rotatedSurfaceNormal_front.x*rotatedLightSource.x + rotatedSurfaceNormal_front.y*rotatedLightSource.y + rotatedSurfaceNormal_front.z*rotatedLightSource.z;
-    float luminance_back = rotatedSurfaceNormal_back.x*rotatedLightSource.x + rotatedSurfaceNormal_back.y*rotatedLightSource.y + rotatedSurfaceNormal_back.z*rotatedLightSource.z;
-
-    // y
-    float i = CUBE_SIZE/2;
-
-    // x
-    for (float j = -CUBE_SIZE/2; j <= CUBE_SIZE/2; j+=SPACING) {
-        // z
-        for (float k = -CUBE_SIZE/2; k <= CUBE_SIZE/2; k+=SPACING) {
-            std::string_view charColor1 = color1;
-            std::string_view charColor2 = color2;
-            if (j > (-CUBE_SIZE/2 + CUBE_SIZE/3) - GRID_SPACING &&
-                    j < (-CUBE_SIZE/2 + CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (j > (CUBE_SIZE/2 - CUBE_SIZE/3) - GRID_SPACING &&
-                    j < (CUBE_SIZE/2 - CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (k > (-CUBE_SIZE/2 + CUBE_SIZE/3) - GRID_SPACING &&
-                    k < (-CUBE_SIZE/2 + CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (k > (CUBE_SIZE/2 - CUBE_SIZE/3) - GRID_SPACING &&
-                    k < (CUBE_SIZE/2 - CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            }
-
-            /* Front Face */
-            updateBuffers(i, j, k, trigValues, buffer, zbuffer, cbuffer, charColor1, luminance_front);
-
-            /* Back Face */
-            updateBuffers(-i, j, k, trigValues, buffer, zbuffer, cbuffer, charColor2, luminance_back);
-        }
-    }
-}
-
-void renderCubeAxis_C(std::vector<float> &trigValues, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<std::string_view> &cbuffer, std::string_view color1, std::string_view color2) {
-    float sinA = trigValues[0], cosA = trigValues[1];
-    float sinB = trigValues[2], cosB = trigValues[3];
-    float sinC = trigValues[4], cosC = trigValues[5];
-
-    Vector3f surfaceNormal_front = {CUBE_SIZE, 0.0f, 0.0f};
-    Vector3f surfaceNormal_back = {-CUBE_SIZE, 0.0f, 0.0f};
-
-    Vector3f rotatedSurfaceNormal_front = {
-        cosA*cosB*surfaceNormal_front.x + (cosA*sinB*sinC - sinA*cosC)*surfaceNormal_front.y + (cosA*sinB*cosC + sinA*sinC)*surfaceNormal_front.z,
-        sinA*cosB*surfaceNormal_front.x + (sinA*sinB*sinC + cosA*cosC)*surfaceNormal_front.y + (sinA*sinB*cosC - cosA*sinC)*surfaceNormal_front.z,
-        -surfaceNormal_front.x*sinB + surfaceNormal_front.y*cosB*sinC + surfaceNormal_front.z*cosB*cosC
-    };
-    normVector(rotatedSurfaceNormal_front);
+// Lighting stage: light direction and per-face luminance/glyph, computed once per frame
+void updateLighting(const Mat3 &rotation, Quat lightOrientation, FaceShading shading[FACE_COUNT]) {
+    rotatedLightSource = vecmath::normalize(vecmath::toMat3(lightOrientation) * lightSource);
 
-    Vector3f rotatedSurfaceNormal_back = {
-        cosA*cosB*surfaceNormal_back.x + (cosA*sinB*sinC - sinA*cosC)*surfaceNormal_back.y + (cosA*sinB*cosC + sinA*sinC)*surfaceNormal_back.z,
-        sinA*cosB*surfaceNormal_back.x + (sinA*sinB*sinC + cosA*cosC)*surfaceNormal_back.y + (sinA*sinB*cosC - cosA*sinC)*surfaceNormal_back.z,
-        -surfaceNormal_back.x*sinB + surfaceNormal_back.y*cosB*sinC + surfaceNormal_back.z*cosB*cosC
-    };
-    normVector(rotatedSurfaceNormal_back);
+    for (int face = 0; face < FACE_COUNT; face++) {
+        Vec3 rotatedSurfaceNormal = vecmath::normalize(rotation * FACE_NORMALS[face]);
 
-    float luminance_front = rotatedSurfaceNormal_front.x*rotatedLightSource.x + rotatedSurfaceNormal_front.y*rotatedLightSource.y + rotatedSurfaceNormal_front.z*rotatedLightSource.z;
-    float luminance_back = rotatedSurfaceNormal_back.x*rotatedLightSource.x + rotatedSurfaceNormal_back.y*rotatedLightSource.y + rotatedSurfaceNormal_back.z*rotatedLightSource.z;
+        // Luminance ranges from -1 to +1 for the dot product of the plane normal and light source normalized 3D unit vectors
+        // If the luminance > 0, then the plane is facing towards the light source
+        // else if luminance < 0, then the plane is facing away from the light source
+        // else if luminance = 0, then the plane and the light source are perpendicular
+        float luminance = vecmath::dot(rotatedSurfaceNormal, rotatedLightSource);
+        int luminance_index = luminance * 11;
 
-    // x
-    float j = CUBE_SIZE/2;
+        int shade = luminance > 0 ? luminance_index : 0;
+        uint8_t shadeOffset = colorMode == COLOR_MODE_16 ? 0 : COLOR_COUNT * shade;
+        shading[face] = {luminance, LUMINANCE_RAMP[shade], shadeOffset};
+    }
+}
 
-    // z
-    for (float k = -CUBE_SIZE/2; k <= CUBE_SIZE/2; k+=SPACING) {
-        // y
-        for (float i = -CUBE_SIZE/2; i <= CUBE_SIZE/2; i+=SPACING) {
-            std::string_view charColor1 = color1;
-            std::string_view charColor2 = color2;
-            if (k > (-CUBE_SIZE/2 + CUBE_SIZE/3) - GRID_SPACING &&
-                    k < (-CUBE_SIZE/2 + CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (k > (CUBE_SIZE/2 - CUBE_SIZE/3) - GRID_SPACING &&
-                    k < (CUBE_SIZE/2 - CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (i > (-CUBE_SIZE/2 + CUBE_SIZE/3) - GRID_SPACING &&
-                    i < (-CUBE_SIZE/2 + CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
-            } else if (i > (CUBE_SIZE/2 - CUBE_SIZE/3) - GRID_SPACING &&
-                    i < (CUBE_SIZE/2 - CUBE_SIZE/3) + GRID_SPACING) {
-                charColor1 = GRID_LINE_COLOR;
-                charColor2 = GRID_LINE_COLOR;
+// Maps each render face's sticker grid onto the cube state's facelets. Render faces use the
+// renderCubeAxis_* axes (outer, inner, fixed); cube space is right-handed with z towards F, so
+// its z axis points out of the screen and the render z axis is flipped.
+void buildStickerFacelets() {
+    std::fill(interiorPalette, interiorPalette + STICKER_PALETTE_SIZE, GRID_LINE_COLOR);
+    centerSticker = (cubeSize / 2) * cubeSize + cubeSize / 2;
+
+    for (int face = 0; face < FACE_COUNT; face++) {
+        const int *axes = FACE_AXES[face / 2];
+        int sign = face % 2 == 0 ? 1 : -1;
+
+        // Surface positions in cube::nxnFaceletPosition's doubled units
+        for (int outer = 0; outer < cubeSize; outer++) {
+            for (int inner = 0; inner < cubeSize; inner++) {
+                int p[3], n[3] = {0, 0, 0};
+                p[axes[0]] = 2 * outer - (cubeSize - 1);
+                p[axes[1]] = 2 * inner - (cubeSize - 1);
+                p[axes[2]] = sign * cubeSize;
+                n[axes[2]] = sign;
+
+                int facelet = cube::nxnFaceletAt(cubeSize, {p[0], p[1], -p[2]}, {n[0], n[1], -n[2]});
+                faceStickerFacelets[face][outer * cubeSize + inner] = facelet;
+                cubeFaceColors[facelet / puzzle.faceletsPerFace] = FACE_COLORS[face];
             }
+        }
 
-            /* Front Face */
-            updateBuffers(i, j, k, trigValues, buffer, zbuffer, cbuffer, charColor1, luminance_front);
-
-            /* Back Face */
-            updateBuffers(i, -j, k, trigValues, buffer, zbuffer, cbuffer, charColor2, luminance_back);
+        for (int sticker = 0; sticker <= STICKER_INDEX_MASK; sticker++) {
+            stickerPalettes[face][STICKER_GRID_LINE | sticker] = GRID_LINE_COLOR;
+            turnPalettes[face][STICKER_GRID_LINE | sticker] = GRID_LINE_COLOR;
         }
     }
 }
 
-void renderFrame(std::vector<char> &buffer, std::vector<char> &buffer_prev, std::vector<std::string_view> &cbuffer, std::vector<std::string_view> &cbuffer_prev, std::vector<float> &zbuffer, std::vector<float> &trigValues) {
-    buffer_prev = buffer;
-    cbuffer_prev = cbuffer;
+// Sticker colors of every face for the current cube state and shading
+void updateStickerPalettes(const cube::NxnState &state, const FaceShading shading[FACE_COUNT], uint8_t palettes[FACE_COUNT][STICKER_PALETTE_SIZE]) {
+    for (int face = 0; face < FACE_COUNT; face++) {
+        for (int sticker = 0; sticker < puzzle.faceletsPerFace; sticker++) {
+            uint8_t faceId = state.facelets[faceStickerFacelets[face][sticker]];
+            palettes[face][sticker] = cubeFaceColors[faceId] + shading[face].shadeOffset;
+        }
+    }
+}
 
-    std::fill(buffer.begin(), buffer.end(), ' ');
-    std::fill(cbuffer.begin(), cbuffer.end(), ANSI_escape_code::color::RESET);
-    std::fill(zbuffer.begin(), zbuffer.end(), 0);
+// Rasterizes one camera-space sample
+void updateBuffers(float x, float y, float z, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer, uint8_t color, char glyph) {
+    float ooz = 1 / z; // "One over z"
 
-    renderCubeAxis_A(trigValues, buffer, zbuffer, cbuffer, ANSI_escape_code::color::YELLOW, ANSI_escape_code::color::WHITE);
-    renderCubeAxis_B(trigValues, buffer, zbuffer, cbuffer, ANSI_escape_code::color::GREEN, ANSI_escape_code::color::BLUE);
-    renderCubeAxis_C(trigValues, buffer, zbuffer, cbuffer, ANSI_escape_code::color::BOLD_RED, ANSI_escape_code::color::RED);
+    int xp = static_cast<int>((RASTER_WIDTH/2) + (K1*rasterScale.w*ooz*x));
+    int yp = static_cast<int>((RASTER_HEIGHT/2) - (K1*rasterScale.h*ooz*y));
 
-    printf("%s", ANSI_escape_code::SET_CURSOR_HOME);
+    int index = xp + yp * RASTER_WIDTH;
+    std::vector<char>::size_type indexLimit = buffer.size();
 
-    std::vector<char>::iterator buffer_prev_iter = buffer_prev.begin();
-    std::vector<std::string_view>::iterator cbuffer_iter = cbuffer.begin();
-    std::vector<std::string_view>::iterator cbuffer_prev_iter = cbuffer_prev.begin();
+    std::vector<char>::iterator bufferIter = buffer.begin();
+    std::vector<uint8_t>::iterator cbufferIter = cbuffer.begin();
+    std::vector<float>::iterator zbufferIter = zbuffer.begin();
 
-    for (std::vector<char>::iterator bufferIter = buffer.begin(); bufferIter != buffer.end(); bufferIter++) {
-        size_t index = bufferIter - buffer.begin();
-        if ((*bufferIter == *(buffer_prev_iter + index)) && 
-            (*(cbuffer_iter + index) == *(cbuffer_prev_iter + index))) {
-            continue;
+    COUNT_FRAGMENTS(fragmentsGenerated);
+    if (index >= 0 && index < indexLimit) {
+#if PROFILING
+        if (showOverdrawHeatmap) {
+            overdrawBuffer[index]++;
+        }
+        if (zbuffer[index] == 0) {
+            COUNT_FRAGMENTS(cellsCovered);
+        }
+#endif
+        if (ooz > zbuffer[index]) {
+            COUNT_FRAGMENTS(fragmentsWritten);
+            *(zbufferIter + index) = ooz;
+            *(cbufferIter + index) = color;
+            *(bufferIter + index) = glyph;
+        } else {
+            COUNT_FRAGMENTS(fragmentsDepthRejected);
         }
+    } else {
+        COUNT_FRAGMENTS(fragmentsOutOfBounds);
+    }
+}
 
-        int x = index % WIDTH;
-        int y = index / WIDTH;
+// Braille backend: depth is tested per dot, and the dot's bit in its cell mask is set for a
+// sticker and cleared for a grid line, so the stickers stay outlined at the full 2x4 resolution
+void updateBraille(float x, float y, float z, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer, uint8_t color) {
+    float ooz = 1 / z; // "One over z"
 
-        // Move cursor, add color, and print char
-        printf("\x1b[%d;%dH%s%s%c", y+1, x+1, ANSI_escape_code::color::RESET, (cbuffer_iter + index)->data(), *bufferIter);
+    int xp = static_cast<int>((RASTER_WIDTH/2) + (K1*rasterScale.w*ooz*x));
+    int yp = static_cast<int>((RASTER_HEIGHT/2) - (K1*rasterScale.h*ooz*y));
+
+    COUNT_FRAGMENTS(fragmentsGenerated);
+    if (xp < 0 || xp >= RASTER_WIDTH || yp < 0 || yp >= RASTER_HEIGHT) {
+        COUNT_FRAGMENTS(fragmentsOutOfBounds);
+        return;
     }
-}
 
-void clearBuffers(std::vector<char> &buffer, std::vector<char> &buffer_prev, std::vector<std::string_view> &cbuffer, std::vector<std::string_view> &cbuffer_prev, std::vector<float> &zbuffer) {
-    std::fill(buffer.begin(), buffer.end(), ' ');
-    std::fill(buffer_prev.begin(), buffer_prev.end(), ' ');
-    std::fill(cbuffer.begin(), cbuffer.end(), ANSI_escape_code::color::RESET);
-    std::fill(cbuffer_prev.begin(), cbuffer_prev.end(), ANSI_escape_code::color::RESET);
-    std::fill(zbuffer.begin(), zbuffer.end(), 0);
+    int index = xp + yp * RASTER_WIDTH;
+#if PROFILING
+    if (showOverdrawHeatmap) {
+        overdrawBuffer[index]++;
+    }
+    if (zbuffer[index] == 0) {
+        COUNT_FRAGMENTS(cellsCovered);
+    }
+#endif
+    if (ooz <= zbuffer[index]) {
+        COUNT_FRAGMENTS(fragmentsDepthRejected);
+        return;
+    }
+
+    COUNT_FRAGMENTS(fragmentsWritten);
+    zbuffer[index] = ooz;
+
+    int cell = (xp >> 1) + (yp >> 2) * WIDTH;
+    uint8_t dot = BRAILLE_DOT_BITS[yp & 3][xp & 1];
+    if (color == GRID_LINE_COLOR) {
+        buffer[cell] &= ~dot;
+    } else {
+        buffer[cell] |= dot;
+        cbuffer[cell] = color;
+    }
 }
 
-void resizeBuffers(std::vector<char> &buffer, std::vector<char> &buffer_prev, std::vector<std::string_view> &cbuffer, std::vector<std::string_view> &cbuffer_prev, std::vector<float> &zbuffer) {
-    buffer.resize((WIDTH * HEIGHT));
-    buffer_prev.resize((WIDTH * HEIGHT));
-    cbuffer.resize((WIDTH * HEIGHT));
-    cbuffer_prev.resize((WIDTH * HEIGHT));
-    zbuffer.resize((WIDTH * HEIGHT));
+// Sample range of a lattice axis inside a clip range
+void clipLatticeAxis(const AxisLattice &lattice, int count, const FaceClip &clip, int &first, int &last) {
+    first = std::lower_bound(lattice.coord.begin(), lattice.coord.begin() + count, clip.lo) - lattice.coord.begin();
+    last = std::lower_bound(lattice.coord.begin(), lattice.coord.begin() + count, clip.hi) - lattice.coord.begin();
 }
 
-Dim2i getTerminalDim() {
-    struct winsize ws;
-    if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) != 0 &&
-        ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws ) != 0 &&
-        ioctl(STDERR_FILENO, TIOCGWINSZ, &ws ) != 0 ) {
-        fprintf(stderr, "ioctl() failed\n");
-        return {0, 0};
+// Streams one face's lattice through the batch transform and rasterizer. Axes are indices into
+// cube space (0 = x/j, 1 = y/i, 2 = z/k); the face lies in the plane axis[fixedAxis] = fixed.
+// A clip keeps the part of the face on one side of a layer cut, on the face's own lattice.
+void renderFace(const Mat4 &view, int outerAxis, int innerAxis, int fixedAxis, float fixed, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer, const uint8_t palette[STICKER_PALETTE_SIZE], char glyph, const FaceClip &clip = FaceClip()) {
+    float h = CUBE_SIZE/2;
+    Vec3 corners[4];
+    for (int c = 0; c < 4; c++) {
+        float p[3];
+        p[outerAxis] = (c & 1) ? h : -h;
+        p[innerAxis] = (c & 2) ? h : -h;
+        p[fixedAxis] = fixed;
+        corners[c] = {p[0], p[1], p[2]};
     }
 
-    return {ws.ws_col, ws.ws_row};
-}
+    int outerCount, innerCount;
+    faceSampleCounts(corners, view, outerCount, innerCount);
 
-void updateDim() {
-    Dim2i terminalDim = getTerminalDim();
+    const AxisLattice &outerLattice = faceLattice.axes[outerCount];
+    const AxisLattice &innerLattice = faceLattice.axes[innerCount];
 
-    if (terminalDim.w && terminalDim.h) {
-        WIDTH = terminalDim.w;
-        HEIGHT = terminalDim.h;
-        K1 = (WIDTH * K2 * 3) / (8 * (sqrt(3)*CUBE_SIZE));
-        SPACING = 3.0f / WIDTH;
+    int outerFirst = 0, outerLast = outerCount;
+    int innerFirst = 0, innerLast = innerCount;
+    if (clip.axis == outerAxis) {
+        clipLatticeAxis(outerLattice, outerCount, clip, outerFirst, outerLast);
+    } else if (clip.axis == innerAxis) {
+        clipLatticeAxis(innerLattice, innerCount, clip, innerFirst, innerLast);
+    }
+    innerCount = innerLast - innerFirst;
+    const uint8_t *innerSticker = innerLattice.innerSticker.data() + innerFirst;
 
-        resizeBuffers(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer);
-        clearBuffers(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer);
-        printf("%s", ANSI_escape_code::ERASE_SCREEN);
+    std::fill(sampleRow.fixed.begin(), sampleRow.fixed.begin() + innerCount, fixed);
+    const float *local[3];
+    local[innerAxis] = innerLattice.coord.data() + innerFirst;
+    local[outerAxis] = sampleRow.outer.data();
+    local[fixedAxis] = sampleRow.fixed.data();
+
+    for (int o = outerFirst; o < outerLast; o++) {
+        std::fill(sampleRow.outer.begin(), sampleRow.outer.begin() + innerCount, outerLattice.coord[o]);
+        uint8_t outerSticker = outerLattice.outerSticker[o];
+
+        vecmath::transformPoints(view, local[0], local[1], local[2], sampleRow.x.data(), sampleRow.y.data(), sampleRow.z.data(), innerCount);
+
+        if (renderMode == RENDER_BRAILLE) {
+            for (int s = 0; s < innerCount; s++) {
+                uint8_t cell = ((outerSticker + innerSticker[s]) & STICKER_INDEX_MASK) | ((outerSticker | innerSticker[s]) & STICKER_GRID_LINE);
+                updateBraille(sampleRow.x[s], sampleRow.y[s], sampleRow.z[s], buffer, zbuffer, cbuffer, palette[cell]);
+            }
+            continue;
+        }
+
+        for (int s = 0; s < innerCount; s++) {
+            uint8_t cell = ((outerSticker + innerSticker[s]) & STICKER_INDEX_MASK) | ((outerSticker | innerSticker[s]) & STICKER_GRID_LINE);
+            updateBuffers(sampleRow.x[s], sampleRow.y[s], sampleRow.z[s], buffer, zbuffer, cbuffer, palette[cell], glyph);
+        }
     }
 }
 
-void handleExit() {
-    printf("%s", ANSI_escape_code::ERASE_SCREEN);
-    printf("%s", ANSI_escape_code::DISABLE_ALT_BUFFER);
+void renderCubeAxis_A(const Mat4 &view, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer, const uint8_t *palette1, const uint8_t *palette2) {
+    // z = ±CUBE_SIZE/2
+    /* Front Face */
+    renderFace(view, 1, 0, 2, CUBE_SIZE/2, buffer, zbuffer, cbuffer, palette1, faceShading[FACE_A_FRONT].glyph);
 
-    printf("%s", ANSI_escape_code::color::RESET);
-    printf("%s", ANSI_escape_code::CURSOR_VISIBLE);
+    /* Back Face */
+    renderFace(view, 1, 0, 2, -CUBE_SIZE/2, buffer, zbuffer, cbuffer, palette2, faceShading[FACE_A_BACK].glyph);
+}
 
-    if (showDebugInfo) {
-        printf("Width: %d | Height: %d\n", WIDTH, HEIGHT);
-        printf("K1: %f | K2: %f | Spacing: %f | Grid Spacing: %f | Buffer Size: %d\n", K1, K2, SPACING, GRID_SPACING, (WIDTH * HEIGHT));
-        printf("Memory Allocations: %d\n", allocCount);
+void renderCubeAxis_B(const Mat4 &view, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer, const uint8_t *palette1, const uint8_t *palette2) {
+    // y = ±CUBE_SIZE/2
+    /* Front Face */
+    renderFace(view, 0, 2, 1, CUBE_SIZE/2, buffer, zbuffer, cbuffer, palette1, faceShading[FACE_B_FRONT].glyph);
 
-        uint32_t frames = frameTimes.size();
-        float frameAvg = std::reduce(frameTimes.begin(), frameTimes.end()) / (frames ? frames : 1);
-        std::cout << "Frames: " << frames 
-            << " | Frame Average: " << (frameAvg / 1000.0f) << " milliseconds (" << frameAvg << " microseconds)" 
-            << " | Average FPS: " << (frames ? (1000000 / static_cast<float>(frameAvg)) : 0) << std::endl;
-    }
+    /* Back Face */
+    renderFace(view, 0, 2, 1, -CUBE_SIZE/2, buffer, zbuffer, cbuffer, palette2, faceShading[FACE_B_BACK].glyph);
 }
 
-void SIGINTCallbackEventHandler(int sigNum) {
-    handleExit();
-    exit(sigNum);
+void renderCubeAxis_C(const Mat4 &view, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer, const uint8_t *palette1, const uint8_t *palette2) {
+    // x = ±CUBE_SIZE/2
+    /* Front Face */
+    renderFace(view, 2, 1, 0, CUBE_SIZE/2, buffer, zbuffer, cbuffer, palette1, faceShading[FACE_C_FRONT].glyph);
+
+    /* Back Face */
+    renderFace(view, 2, 1, 0, -CUBE_SIZE/2, buffer, zbuffer, cbuffer, palette2, faceShading[FACE_C_BACK].glyph);
 }
 
-void SIGWINCHCallbackEventHandler(int sigNum) {
-    updateDim();
+// True if the face through point with the given outward normal (both in cube space) faces the camera
+bool facesCamera(const Mat3 &rotation, const Mat4 &view, Vec3 normal, Vec3 point) {
+    return vecmath::dot(rotation * normal, vecmath::transformPoint(view, point)) < 0;
 }
 
-int main (int argc, char *argv[]) {
-    signal(SIGINT, SIGINTCallbackEventHandler);
-    signal(SIGWINCH, SIGWINCHCallbackEventHandler);
+// Layer turn frame as rigid groups of cubies: the slab of the turning layer uses the view times
+// the layer rotation, the cubies on either side of it (one group for an outer layer, two for an
+// inner slice) the frame's view. Each group is drawn as one box on the existing face lattices
+// (its faces clipped at the cuts), so the faces between cubies of the same group are never
+// generated. Every box is convex, so its faces turned away from the camera are skipped too. The
+// only interior faces are the ones at the cuts, drawn in the grid line color.
+void renderLayerTurn(const Mat3 &rotation, const Mat4 &view, const Mat3 &turnRotation, const Mat4 &turnView, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer) {
+    cube::Ivec3 n = cube::FACE_NORMAL[cube::nxnMoveFace(layerTurn.move)];
+    int axis = n.x ? 0 : n.y ? 1 : 2;
+    float sign = (n.x + n.y - n.z) > 0 ? 1.0f : -1.0f; // cube::FaceId z points the other way
+    int layer = cube::nxnMoveLayer(layerTurn.move);
+
+    // The slab [lo, hi) along the axis, with its cuts on the sticker boundaries of the lattice
+    const float h = CUBE_SIZE/2;
+    const float outside = CUBE_SIZE; // past the last lattice sample
+    const float stickerSize = CUBE_SIZE / cubeSize;
+    float lo = sign > 0 ? h - (layer + 1) * stickerSize : -h + layer * stickerSize;
+    float hi = sign > 0 ? h - layer * stickerSize : -h + (layer + 1) * stickerSize;
+    bool cutBelow = sign > 0 || layer > 0; // static cubies on the lo side
+    bool cutAbove = sign < 0 || layer > 0; // static cubies on the hi side
+
+    FaceClip layerClip = {axis, cutBelow ? lo : -outside, cutAbove ? hi : outside};
+    FaceClip belowClip = {axis, -outside, lo};
+    FaceClip aboveClip = {axis, hi, outside};
+
+    for (int face = 0; face < FACE_COUNT; face++) {
+        const int *axes = FACE_AXES[face / 2];
+        float fixed = face % 2 == 0 ? h : -h;
+        Vec3 center = FACE_NORMALS[face] * 0.5f;
+        bool staticVisible = facesCamera(rotation, view, FACE_NORMALS[face], center);
+        bool layerVisible = facesCamera(turnRotation, turnView, FACE_NORMALS[face], center);
+
+        if (axes[2] == axis) {
+            bool turning = fixed > 0 ? !cutAbove : !cutBelow;
+            if (turning ? layerVisible : staticVisible) {
+                renderFace(turning ? turnView : view, axes[0], axes[1], axes[2], fixed, buffer, zbuffer, cbuffer,
+                    turning ? turnPalettes[face] : stickerPalettes[face], turning ? turnShading[face].glyph : faceShading[face].glyph);
+            }
+            continue;
+        }
 
-    printf("%s", ANSI_escape_code::ENABLE_ALT_BUFFER);
-    printf("%s", ANSI_escape_code::ERASE_SCREEN);
-    printf("%s", ANSI_escape_code::CURSOR_INVISIBLE);
+        if (staticVisible && cutBelow) {
+            renderFace(view, axes[0], axes[1], axes[2], fixed, buffer, zbuffer, cbuffer, stickerPalettes[face], faceShading[face].glyph, belowClip);
+        }
+        if (staticVisible && cutAbove) {
+            renderFace(view, axes[0], axes[1], axes[2], fixed, buffer, zbuffer, cbuffer, stickerPalettes[face], faceShading[face].glyph, aboveClip);
+        }
+        if (layerVisible) {
+            renderFace(turnView, axes[0], axes[1], axes[2], fixed, buffer, zbuffer, cbuffer, turnPalettes[face], turnShading[face].glyph, layerClip);
+        }
+    }
 
-    updateDim();
+    // At each cut the static group's face points at the slab and the slab's face back at it.
+    // Render face pair 2 - axis lies across the axis, its even face on the positive side.
+    int pair = 2 - axis;
+    const int *axes = FACE_AXES[pair];
+    for (int side = 0; side < 2; side++) {
+        if (!(side == 0 ? cutBelow : cutAbove)) {
+            continue;
+        }
 
-    frameTimes.reserve(5000);
+        float cut = side == 0 ? lo : hi;
+        int towardsLayer = pair * 2 + side; // positive normal below the slab, negative above
+        int awayFromLayer = pair * 2 + 1 - side;
+        float p[3] = {0.0f, 0.0f, 0.0f};
+        p[axis] = cut;
+        Vec3 point = {p[0], p[1], p[2]};
+        Vec3 normal = FACE_NORMALS[towardsLayer];
 
-    float A = -M_PI_2; // Axis facing the screen (z-axis)
-    float B = -M_PI_2; // Up / Down axis (y-axis)
-    float C = M_PI_2 + M_PI_4; // Left / Right axis (x-axis)
+        if (facesCamera(rotation, view, normal, point)) {
+            renderFace(view, axes[0], axes[1], axes[2], cut, buffer, zbuffer, cbuffer, interiorPalette, faceShading[towardsLayer].glyph);
+        }
+        if (facesCamera(turnRotation, turnView, -normal, point)) {
+            renderFace(turnView, axes[0], axes[1], axes[2], cut, buffer, zbuffer, cbuffer, interiorPalette, turnShading[awayFromLayer].glyph);
+        }
+    }
+}
 
-    float sinA = sin(A), cosA = cos(A);
-    float sinB = sin(B), cosB = cos(B);
-    float sinC = sin(C), cosC = cos(C);
-    trigValues = {sinA, cosA, sinB, cosB, sinC, cosC};
+// Screen-space outline of a front-facing face as edge functions a*x + b*y + c >= 0 inside
+struct ScreenQuad {
+    int face;
+    float x[4], y[4];
+    float a[4], b[4], c[4];
+};
 
-    float D = 0.0f;
-    float E = 0.0f;
-    float F = 0.0f;
+// Returns false for faces turned away from the camera
+bool projectFaceQuad(int face, const Mat3 &rotation, const Mat4 &view, ScreenQuad &quad) {
+    Vec3 normal = FACE_NORMALS[face];
+    Vec3 center = vecmath::transformPoint(view, normal * 0.5f);
+    if (vecmath::dot(rotation * normal, center) >= 0) {
+        return false;
+    }
 
-    float sinD = sin(D), cosD = cos(D);
-    float sinE = sin(E), cosE = cos(E);
-    float sinF = sin(F), cosF = cos(F);
+    // Walk the corners in order around the face
+    float h = CUBE_SIZE/2;
+    int fixedAxis = normal.x != 0 ? 0 : normal.y != 0 ? 1 : 2;
+    int uAxis = (fixedAxis + 1) % 3;
+    int vAxis = (fixedAxis + 2) % 3;
+    const float cornerU[4] = {-h, h, h, -h};
+    const float cornerV[4] = {-h, -h, h, h};
+
+    quad.face = face;
+    for (int c = 0; c < 4; c++) {
+        float p[3];
+        p[fixedAxis] = normal[fixedAxis] * 0.5f;
+        p[uAxis] = cornerU[c];
+        p[vAxis] = cornerV[c];
+        projectPoint({p[0], p[1], p[2]}, view, quad.x[c], quad.y[c]);
+    }
 
-    rotatedLightSource = {
-        cosD*cosE*lightSource.x + (cosD*sinE*sinF - sinD*cosF)*lightSource.y + (cosD*sinE*cosF + sinD*sinF)*lightSource.z,
-        sinD*cosE*lightSource.x + (sinD*sinE*sinF + cosD*cosF)*lightSource.y + (sinD*sinE*cosF - cosD*sinF)*lightSource.z,
-        -lightSource.x*sinE + lightSource.y*cosE*sinF + lightSource.z*cosE*cosF
-    };
-    normVector(rotatedLightSource);
+    float cx = (quad.x[0] + quad.x[1] + quad.x[2] + quad.x[3]) / 4;
+    float cy = (quad.y[0] + quad.y[1] + quad.y[2] + quad.y[3]) / 4;
+    for (int e = 0; e < 4; e++) {
+        int n = (e + 1) % 4;
+        quad.a[e] = quad.y[e] - quad.y[n];
+        quad.b[e] = quad.x[n] - quad.x[e];
+        quad.c[e] = quad.x[e] * quad.y[n] - quad.x[n] * quad.y[e];
+
+        // Orient every edge so the centroid is inside
+        if (quad.a[e] * cx + quad.b[e] * cy + quad.c[e] < 0) {
+            quad.a[e] = -quad.a[e];
+            quad.b[e] = -quad.b[e];
+            quad.c[e] = -quad.c[e];
+        }
+    }
+    return true;
+}
 
-    nextFrame = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now());
-    previousFrame = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now());
+// Marks every cell a projected edge passes through, stepping at most half a cell at a time
+void markEdgeCells(float x0, float y0, float x1, float y1, EdgeCells &edges) {
+    int steps = static_cast<int>(ceil(std::max(fabsf(x1 - x0), fabsf(y1 - y0)) * 2)) + 1;
+    for (int s = 0; s <= steps; s++) {
+        float t = static_cast<float>(s) / steps;
+        int xp = static_cast<int>(floorf(x0 + (x1 - x0) * t));
+        int yp = static_cast<int>(floorf(y0 + (y1 - y0) * t));
+        if (xp < 0 || xp >= RASTER_WIDTH || yp < 0 || yp >= RASTER_HEIGHT) {
+            continue;
+        }
 
-    while (true) {
-        PROFILE_SCOPE(frameTimes);
+        int index = xp + yp * RASTER_WIDTH;
+        if (!edges.mask[index]) {
+            edges.mask[index] = 1;
+            edges.cells.push_back(index);
+        }
+    }
+}
 
-        A += 0.03f;
-        B += 0.02f;
-        C += 0.01f;
-        sinA = sin(A), cosA = cos(A);
-        sinB = sin(B), cosB = cos(B);
-        sinC = sin(C), cosC = cos(C);
-        trigValues = {sinA, cosA, sinB, cosB, sinC, cosC};
+// Sticker of a face under most of its covered subsamples in an edge cell, for cells no fragment
+// landed in. Each subsample is traced back onto the face plane and classified into stripes as
+// the face lattice is.
+int edgeCellSticker(const ScreenQuad &quad, const Mat3 &rotation, const Mat4 &view, float cellX, float cellY, const float boundary[cube::NXN_MAX_SIZE + 1]) {
+    const int *axes = FACE_AXES[quad.face / 2];
+    float fixed = quad.face % 2 == 0 ? CUBE_SIZE/2 : -CUBE_SIZE/2;
+    int samples = antialiasSamples;
+    float subsampleStep = 1.0f / samples;
+
+    int votes[cube::NXN_MAX_SIZE * cube::NXN_MAX_SIZE] = {};
+    int sticker = centerSticker, best = 0; // kept only if no subsample is covered
+    for (int group = 0; group < samples * samples / 4; group++) {
+        float px[4], py[4];
+        for (int n = 0; n < 4; n++) {
+            int sample = group * 4 + n;
+            px[n] = cellX + ((sample % samples) + 0.5f) * subsampleStep;
+            py[n] = cellY + ((sample / samples) + 0.5f) * subsampleStep;
+        }
 
-        /* Rotate Light Source */
-        // D += 0.01f;
-        // E += 0.01f;
-        // F += 0.01f;
-        // sinD = sin(D), cosD = cos(D);
-        // sinE = sin(E), cosE = cos(E);
-        // sinF = sin(F), cosF = cos(F);
-        // rotatedLightSource = {
-        //     cosD*cosE*lightSource.x + (cosD*sinE*sinF - sinD*cosF)*lightSource.y + (cosD*sinE*cosF + sinD*sinF)*lightSource.z,
-        //     sinD*cosE*lightSource.x + (sinD*sinE*sinF + cosD*cosF)*lightSource.y + (sinD*sinE*cosF - cosD*sinF)*lightSource.z,
-        //     -lightSource.x*sinE + lightSource.y*cosE*sinF + lightSource.z*cosE*cosF
-        // };
-        // normVector(rotatedLightSource);
-
-        renderFrame(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer, trigValues);
+        unsigned mask = vecmath::insideConvex4(quad.a, quad.b, quad.c, 4, px, py);
+        for (int n = 0; n < 4; n++) {
+            if (!(mask >> n & 1)) {
+                continue;
+            }
+            Vec3 p = unprojectToFace(px[n], py[n], rotation, view, axes[2], fixed);
+            int candidate = stickerStripe(boundary, p[axes[0]]) * cubeSize + stickerStripe(boundary, p[axes[1]]);
+            if (++votes[candidate] > best) {
+                best = votes[candidate];
+                sticker = candidate;
+            }
+        }
+    }
+    return sticker;
+}
+
+// Supersamples only the cells on projected face edges: coverage of the visible faces is
+// accumulated over antialiasSamples^2 subsamples and scales the glyph ramp, interior cells
+// keep their single splatted sample.
+void antialiasEdges(const Mat3 &rotation, const Mat4 &view, std::vector<char> &buffer, std::vector<float> &zbuffer, std::vector<uint8_t> &cbuffer) {
+    ScreenQuad quads[3];
+    int quadCount = 0;
+    for (int face = 0; face < FACE_COUNT && quadCount < 3; face++) {
+        if (projectFaceQuad(face, rotation, view, quads[quadCount])) {
+            quadCount++;
+        }
+    }
+
+    for (int q = 0; q < quadCount; q++) {
+        for (int e = 0; e < 4; e++) {
+            int n = (e + 1) % 4;
+            markEdgeCells(quads[q].x[e], quads[q].y[e], quads[q].x[n], quads[q].y[n], edgeCells);
+        }
+    }
+    edgeCells.total += edgeCells.cells.size();
+
+    int samples = antialiasSamples;
+    float subsampleStep = 1.0f / samples;
+    float boundary[cube::NXN_MAX_SIZE + 1];
+    stickerBoundaries(boundary);
+
+    for (int index : edgeCells.cells) {
+        edgeCells.mask[index] = 0;
+        float cellX = index % WIDTH;
+        float cellY = index / WIDTH;
+
+        int faceCoverage[3] = {0, 0, 0};
+        int covered = 0;
+
+        // Four subsamples per SIMD group: a 2x2 cell is one group, a 4x4 cell is one group per row
+        for (int group = 0; group < samples * samples / 4; group++) {
+            float px[4], py[4];
+            for (int n = 0; n < 4; n++) {
+                int sample = group * 4 + n;
+                px[n] = cellX + ((sample % samples) + 0.5f) * subsampleStep;
+                py[n] = cellY + ((sample / samples) + 0.5f) * subsampleStep;
+            }
+
+            unsigned coveredMask = 0;
+            for (int q = 0; q < quadCount; q++) {
+                unsigned mask = vecmath::insideConvex4(quads[q].a, quads[q].b, quads[q].c, 4, px, py);
+                faceCoverage[q] += __builtin_popcount(mask);
+                coveredMask |= mask;
+            }
+            covered += __builtin_popcount(coveredMask);
+        }
+
+        if (covered == 0) {
+            buffer[index] = ' ';
+            cbuffer[index] = COLOR_DEFAULT;
+            continue;
+        }
+
+        int majority = 0;
+        for (int q = 1; q < quadCount; q++) {
+            if (faceCoverage[q] > faceCoverage[majority]) {
+                majority = q;
+            }
+        }
+
+        int face = quads[majority].face;
+        float coverage = static_cast<float>(covered) / (samples * samples);
+        float luminance = faceShading[face].luminance;
+        int luminance_index = luminance * 11 * coverage;
+
+        buffer[index] = LUMINANCE_RAMP[luminance > 0 ? luminance_index : 0];
+        if (zbuffer[index] == 0) {
+            cbuffer[index] = stickerPalettes[face][edgeCellSticker(quads[majority], rotation, view, cellX, cellY, boundary)];
+        }
+    }
+    edgeCells.cells.clear();
+}
+
+// Debug view: replaces the shaded cube with the number of in-bounds fragments per cell
+void renderOverdrawHeatmap(std::vector<char> &buffer, std::vector<uint8_t> &cbuffer, std::vector<uint16_t> &overdrawBuffer) {
+    const uint8_t heatColors[] = {
+        COLOR_DEFAULT, COLOR_BLUE, COLOR_CYAN,
+        COLOR_GREEN, COLOR_YELLOW, COLOR_BOLD_YELLOW,
+        COLOR_RED, COLOR_BOLD_RED, COLOR_BOLD_MAGENTA
+    };
+    const int heatLevels = sizeof(heatColors) / sizeof(heatColors[0]);
+
+    // Braille cells light the dots that received fragments, colored by the busiest one
+    if (renderMode == RENDER_BRAILLE) {
+        for (int cell = 0; cell < WIDTH * HEIGHT; cell++) {
+            int x = (cell % WIDTH) * 2;
+            int y = (cell / WIDTH) * 4;
+            uint8_t mask = 0;
+            int maxCount = 0;
+            for (int dy = 0; dy < 4; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int count = overdrawBuffer[(x + dx) + (y + dy) * RASTER_WIDTH];
+                    if (count) {
+                        mask |= BRAILLE_DOT_BITS[dy][dx];
+                        maxCount = std::max(maxCount, count);
+                    }
+                }
+            }
+            buffer[cell] = mask;
+            cbuffer[cell] = heatColors[std::min(maxCount, heatLevels - 1)];
+        }
+        return;
+    }
+
+    for (size_t index = 0; index < overdrawBuffer.size(); index++) {
+        int count = overdrawBuffer[index];
+        buffer[index] = count == 0 ? ' ' : count < 10 ? '0' + count : '+';
+        cbuffer[index] = heatColors[std::min(count, heatLevels - 1)];
+    }
+}
+
+void appendNumber(std::string &out, int value) {
+    char digits[12];
+    int length = 0;
+    do {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (length) {
+        out += digits[--length];
+    }
+}
+
+// Starts on row = 1, col = 1
+void appendCursorPos(std::string &out, int row, int col) {
+    out += "\x1b[";
+    appendNumber(out, row);
+    out += ';';
+    appendNumber(out, col);
+    out += 'H';
+}
+
+// Emits one SGR sequence with only the parameters that differ from the terminal's current colors
+void appendColorChange(std::string &out, uint8_t fg, uint8_t bg, uint8_t &currentFg, uint8_t &currentBg) {
+    if (fg == currentFg && bg == currentBg) {
+        return;
+    }
+
+    out += "\x1b[";
+    if (fg != currentFg) {
+        appendSgrParams(out, sgrForeground, fg);
+    }
+    if (bg != currentBg) {
+        if (fg != currentFg) {
+            out += ';';
+        }
+        appendSgrParams(out, sgrBackground, bg);
+    }
+    out += 'm';
+    currentFg = fg;
+    currentBg = bg;
+}
+
+// One glyph per cell; every changed cell is addressed, reset and recolored on its own
+void encodeAscii(std::string &out, const std::vector<char> &buffer, const std::vector<char> &buffer_prev, const std::vector<uint8_t> &cbuffer, const std::vector<uint8_t> &cbuffer_prev) {
+    out += ANSI_escape_code::SET_CURSOR_HOME;
+
+    for (size_t index = 0; index < buffer.size(); index++) {
+        if (buffer[index] == buffer_prev[index] && cbuffer[index] == cbuffer_prev[index]) {
+            continue;
+        }
+
+        int x = index % WIDTH;
+        int y = index / WIDTH;
+
+        // Move cursor, add color, and print char
+        appendCursorPos(out, y+1, x+1);
+        out += ANSI_escape_code::color::RESET;
+        out += "\x1b[";
+        appendSgrParams(out, sgrForeground, cbuffer[index]);
+        out += 'm';
+        out += buffer[index];
+        outputStats.cellsUpdated++;
+    }
+}
+
+// Two raster rows per terminal row: the upper pixel is the foreground of U+2580 and the lower
+// pixel its background. The cursor is only moved when the next changed cell is not the adjacent one.
+void encodeHalfBlock(std::string &out, const std::vector<uint8_t> &cbuffer, const std::vector<uint8_t> &cbuffer_prev) {
+    const char *UPPER_HALF_BLOCK = "\u2580";
+    const char *LOWER_HALF_BLOCK = "\u2584";
+
+    // Every frame ends with a reset, so the terminal starts out in its default colors
+    uint8_t currentFg = COLOR_DEFAULT;
+    uint8_t currentBg = COLOR_DEFAULT;
+    int cursor = -1; // cell the terminal cursor is on, -1 if unknown
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            int upper = x + (2 * y) * RASTER_WIDTH;
+            int lower = upper + RASTER_WIDTH;
+            uint8_t top = cbuffer[upper];
+            uint8_t bottom = cbuffer[lower];
+            if (top == cbuffer_prev[upper] && bottom == cbuffer_prev[lower]) {
+                continue;
+            }
+
+            // Uniform cells are a background-colored space, and an empty top pixel flips to the
+            // lower half block so it shows the terminal's own background
+            const char *glyph = UPPER_HALF_BLOCK;
+            uint8_t fg = top;
+            uint8_t bg = bottom;
+            if (top == bottom) {
+                glyph = " ";
+                fg = currentFg;
+            } else if (top == COLOR_DEFAULT) {
+                glyph = LOWER_HALF_BLOCK;
+                fg = bottom;
+                bg = COLOR_DEFAULT;
+            }
+
+            int cell = x + y * WIDTH;
+            if (cell != cursor) {
+                appendCursorPos(out, y+1, x+1);
+            }
+
+            appendColorChange(out, fg, bg, currentFg, currentBg);
+            out += glyph;
+            outputStats.cellsUpdated++;
+
+            // Writing the last column leaves the cursor in the pending wrap state
+            cursor = x + 1 < WIDTH ? cell + 1 : -1;
+        }
+    }
+
+    out += ANSI_escape_code::color::RESET;
+}
+
+// One dot mask per cell drawn in the cell's color with the pre-encoded braille glyphs; cells
+// without dots are a plain space. Cursor and color state are tracked as in the half-block mode.
+void encodeBraille(std::string &out, const std::vector<char> &buffer, const std::vector<char> &buffer_prev, const std::vector<uint8_t> &cbuffer, const std::vector<uint8_t> &cbuffer_prev) {
+    uint8_t currentFg = COLOR_DEFAULT;
+    uint8_t currentBg = COLOR_DEFAULT;
+    int cursor = -1;
+
+    for (int cell = 0; cell < WIDTH * HEIGHT; cell++) {
+        uint8_t mask = buffer[cell];
+        if (buffer[cell] == buffer_prev[cell] && (mask == 0 || cbuffer[cell] == cbuffer_prev[cell])) {
+            continue;
+        }
+
+        if (cell != cursor) {
+            appendCursorPos(out, cell / WIDTH + 1, cell % WIDTH + 1);
+        }
+
+        if (mask) {
+            appendColorChange(out, cbuffer[cell], COLOR_DEFAULT, currentFg, currentBg);
+            out.append(BRAILLE_GLYPHS.bytes[mask], 3);
+        } else {
+            out += ' ';
+        }
+        outputStats.cellsUpdated++;
+
+        cursor = (cell + 1) % WIDTH ? cell + 1 : -1;
+    }
+
+    out += ANSI_escape_code::color::RESET;
+}
+
+void renderFrame(std::vector<char> &buffer, std::vector<char> &buffer_prev, std::vector<uint8_t> &cbuffer, std::vector<uint8_t> &cbuffer_prev, std::vector<float> &zbuffer, Mat3 &rotation) {
+    buffer_prev = buffer;
+    cbuffer_prev = cbuffer;
+
+    std::fill(buffer.begin(), buffer.end(), renderMode == RENDER_BRAILLE ? 0 : ' ');
+    std::fill(cbuffer.begin(), cbuffer.end(), COLOR_DEFAULT);
+    std::fill(zbuffer.begin(), zbuffer.end(), 0);
+    if (showOverdrawHeatmap) {
+        std::fill(overdrawBuffer.begin(), overdrawBuffer.end(), 0);
+    }
+
+    bool turning = layerTurn.move >= 0;
+    Mat3 turnRotation;
+    {
+        PROFILE_STAGE(lightingTimes);
+        updateLighting(rotation, lightOrientation, faceShading);
+        updateStickerPalettes(cubeState, faceShading, stickerPalettes);
+
+        if (turning) {
+            cube::Ivec3 n = cube::FACE_NORMAL[cube::nxnMoveFace(layerTurn.move)];
+            Vec3 axis = {static_cast<float>(n.x), static_cast<float>(n.y), static_cast<float>(-n.z)};
+            turnRotation = rotation * vecmath::toMat3(vecmath::quatFromAxisAngle(axis, layerTurn.angle));
+            updateLighting(turnRotation, lightOrientation, turnShading);
+            updateStickerPalettes(cubeState, turnShading, turnPalettes);
+        }
+    }
+
+    Mat4 view = vecmath::affine(rotation, {0.0f, 0.0f, K2});
+
+    {
+        PROFILE_STAGE(rasterTimes);
+        if (turning) {
+            renderLayerTurn(rotation, view, turnRotation, vecmath::affine(turnRotation, {0.0f, 0.0f, K2}), buffer, zbuffer, cbuffer);
+        } else {
+            renderCubeAxis_A(view, buffer, zbuffer, cbuffer, stickerPalettes[FACE_A_FRONT], stickerPalettes[FACE_A_BACK]);
+            renderCubeAxis_B(view, buffer, zbuffer, cbuffer, stickerPalettes[FACE_B_FRONT], stickerPalettes[FACE_B_BACK]);
+            renderCubeAxis_C(view, buffer, zbuffer, cbuffer, stickerPalettes[FACE_C_FRONT], stickerPalettes[FACE_C_BACK]);
+        }
+    }
+#if PROFILING
+    if (turning) {
+        turnRasterTimes.push_back(rasterTimes.back());
+    }
+#endif
+
+    // The edge quads are the whole cube's, so turn frames keep their splatted edges
+    if (antialiasSamples && renderMode == RENDER_ASCII && !showOverdrawHeatmap && !turning) {
+        PROFILE_STAGE(antialiasTimes);
+        antialiasEdges(rotation, view, buffer, zbuffer, cbuffer);
+    }
+
+    rasterStats.frames++;
+
+    if (showOverdrawHeatmap) {
+        renderOverdrawHeatmap(buffer, cbuffer, overdrawBuffer);
+    }
+
+    frameOutput.clear();
+    if (renderMode == RENDER_HALF_BLOCK) {
+        encodeHalfBlock(frameOutput, cbuffer, cbuffer_prev);
+    } else if (renderMode == RENDER_BRAILLE) {
+        encodeBraille(frameOutput, buffer, buffer_prev, cbuffer, cbuffer_prev);
+    } else {
+        encodeAscii(frameOutput, buffer, buffer_prev, cbuffer, cbuffer_prev);
+    }
+
+    fwrite(frameOutput.data(), 1, frameOutput.size(), stdout);
+    outputStats.bytes += frameOutput.size();
+    outputStats.frames++;
+}
+
+void clearBuffers(std::vector<char> &buffer, std::vector<char> &buffer_prev, std::vector<uint8_t> &cbuffer, std::vector<uint8_t> &cbuffer_prev, std::vector<float> &zbuffer) {
+    std::fill(buffer.begin(), buffer.end(), renderMode == RENDER_BRAILLE ? 0 : ' ');
+    std::fill(buffer_prev.begin(), buffer_prev.end(), renderMode == RENDER_BRAILLE ? 0 : ' ');
+    std::fill(cbuffer.begin(), cbuffer.end(), COLOR_DEFAULT);
+    std::fill(cbuffer_prev.begin(), cbuffer_prev.end(), COLOR_DEFAULT);
+    std::fill(zbuffer.begin(), zbuffer.end(), 0);
+}
+
+void resizeBuffers(std::vector<char> &buffer, std::vector<char> &buffer_prev, std::vector<uint8_t> &cbuffer, std::vector<uint8_t> &cbuffer_prev, std::vector<float> &zbuffer) {
+    int frameSize = renderMode == RENDER_BRAILLE ? (WIDTH * HEIGHT) : (RASTER_WIDTH * RASTER_HEIGHT);
+    buffer.resize(frameSize);
+    buffer_prev.resize(frameSize);
+    cbuffer.resize(frameSize);
+    cbuffer_prev.resize(frameSize);
+    zbuffer.resize((RASTER_WIDTH * RASTER_HEIGHT));
+    overdrawBuffer.resize((RASTER_WIDTH * RASTER_HEIGHT));
+    edgeCells.mask.assign((RASTER_WIDTH * RASTER_HEIGHT), 0);
+    edgeCells.cells.reserve(4 * (RASTER_WIDTH + RASTER_HEIGHT));
+
+    // Worst case is every cell changing: a cursor move, two SGR sequences and a 3 byte glyph
+    frameOutput.reserve(WIDTH * HEIGHT * 32);
+}
+
+Dim2i getTerminalDim() {
+    struct winsize ws;
+    if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) != 0 &&
+        ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws ) != 0 &&
+        ioctl(STDERR_FILENO, TIOCGWINSZ, &ws ) != 0 ) {
+        fprintf(stderr, "ioctl() failed\n");
+        return {0, 0};
+    }
+
+    return {ws.ws_col, ws.ws_row};
+}
+
+void updateDim() {
+    Dim2i terminalDim = getTerminalDim();
+
+    if (terminalDim.w && terminalDim.h) {
+        WIDTH = terminalDim.w;
+        HEIGHT = terminalDim.h;
+        RASTER_WIDTH = WIDTH * rasterScale.w;
+        RASTER_HEIGHT = HEIGHT * rasterScale.h;
+        K1 = (WIDTH * K2 * 3) / (8 * (sqrt(3)*CUBE_SIZE));
+        SPACING = 3.0f / WIDTH;
+
+        buildFaceLattice(faceLattice);
+        resizeBuffers(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer);
+        clearBuffers(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer);
+        printf("%s", ANSI_escape_code::ERASE_SCREEN);
+    }
+}
+
+void handleExit() {
+    printf("%s", ANSI_escape_code::ERASE_SCREEN);
+    printf("%s", ANSI_escape_code::DISABLE_ALT_BUFFER);
+
+    printf("%s", ANSI_escape_code::color::RESET);
+    printf("%s", ANSI_escape_code::CURSOR_VISIBLE);
+
+    if (showDebugInfo) {
+        printf("Width: %d | Height: %d\n", WIDTH, HEIGHT);
+        printf("K1: %f | K2: %f | Spacing: %f | Grid Spacing: %f | Buffer Size: %d (%dx%d raster)\n", K1, K2, SPACING, GRID_SPACING, (RASTER_WIDTH * RASTER_HEIGHT), RASTER_WIDTH, RASTER_HEIGHT);
+        printf("Face Lattice: up to %dx%d samples | Lattice Memory: %zu bytes | Lattice Build Time: %dus\n", faceLattice.maxSamplesPerAxis, faceLattice.maxSamplesPerAxis, faceLattice.memoryBytes(), faceLattice.buildTime);
+
+#if PROFILING
+        uint32_t rasterFrames = rasterStats.frames ? rasterStats.frames : 1;
+        uint64_t fixedSamples = 6 * faceLattice.fixedSamplesPerAxis * faceLattice.fixedSamplesPerAxis;
+        printf("Fragments/Frame: %llu generated (fixed lattice: %llu) | %llu out of bounds | %llu depth rejected | %llu written | %llu cells covered | Overdraw: %.2f\n",
+            static_cast<unsigned long long>(rasterStats.fragmentsGenerated / rasterFrames), static_cast<unsigned long long>(fixedSamples),
+            static_cast<unsigned long long>(rasterStats.fragmentsOutOfBounds / rasterFrames),
+            static_cast<unsigned long long>(rasterStats.fragmentsDepthRejected / rasterFrames),
+            static_cast<unsigned long long>(rasterStats.fragmentsWritten / rasterFrames),
+            static_cast<unsigned long long>(rasterStats.cellsCovered / rasterFrames), rasterStats.overdraw());
+#endif
+        printf("Memory Allocations: %d\n", allocCount);
+
+        uint32_t outputFrames = outputStats.frames ? outputStats.frames : 1;
+        printf("SGR Tables (%s): %zu + %zu bytes for %d shaded colors\n",
+            colorMode == COLOR_MODE_256 ? "256 colors" : colorMode == COLOR_MODE_TRUECOLOR ? "truecolor" : "16 colors",
+            sizeof(SgrTable) - sizeof(std::string) + sgrForeground.bytes.size(), sizeof(SgrTable) - sizeof(std::string) + sgrBackground.bytes.size(), SHADED_COLOR_COUNT);
+        printf("Output (%s): %llu bytes/frame | %llu cells updated/frame | %.1f bytes/updated cell | %.2f bytes/raster pixel\n",
+            renderMode == RENDER_HALF_BLOCK ? "half-block" : renderMode == RENDER_BRAILLE ? "braille" : "ascii",
+            static_cast<unsigned long long>(outputStats.bytes / outputFrames),
+            static_cast<unsigned long long>(outputStats.cellsUpdated / outputFrames),
+            outputStats.cellsUpdated ? static_cast<double>(outputStats.bytes) / outputStats.cellsUpdated : 0.0,
+            static_cast<double>(outputStats.bytes) / outputFrames / (RASTER_WIDTH * RASTER_HEIGHT));
+
+        uint32_t frames = frameTimes.size();
+        float frameAvg = std::reduce(frameTimes.begin(), frameTimes.end()) / (frames ? frames : 1);
+        std::cout << "Frames: " << frames 
+            << " | Frame Average: " << (frameAvg / 1000.0f) << " milliseconds (" << frameAvg << " microseconds)" 
+            << " | Average FPS: " << (frames ? (1000000 / static_cast<float>(frameAvg)) : 0) << std::endl;
+
+#if PROFILING
+        uint32_t stageFrames = rasterTimes.size() ? rasterTimes.size() : 1;
+        double lightingAvg = std::accumulate(lightingTimes.begin(), lightingTimes.end(), 0.0) / stageFrames;
+        double rasterAvg = std::accumulate(rasterTimes.begin(), rasterTimes.end(), 0.0) / stageFrames;
+        uint64_t fragments = rasterStats.fragmentsGenerated ? rasterStats.fragmentsGenerated : 1;
+        printf("Lighting Stage: %.0fns/frame | Raster Stage: %.1fus/frame (%.2fns/fragment)\n",
+            lightingAvg, rasterAvg / 1000.0, std::accumulate(rasterTimes.begin(), rasterTimes.end(), 0.0) / fragments);
+
+        if (!turnRasterTimes.empty()) {
+            double turnAvg = std::accumulate(turnRasterTimes.begin(), turnRasterTimes.end(), 0.0) / turnRasterTimes.size();
+            double staticAvg = rasterTimes.size() > turnRasterTimes.size() ?
+                (std::accumulate(rasterTimes.begin(), rasterTimes.end(), 0.0) - turnRasterTimes.size() * turnAvg) / (rasterTimes.size() - turnRasterTimes.size()) : 0.0;
+            printf("Layer Turn Frames: %zu | Raster Stage: %.1fus/turn frame vs %.1fus/static frame (%.2fx)\n",
+                turnRasterTimes.size(), turnAvg / 1000.0, staticAvg / 1000.0, staticAvg ? turnAvg / staticAvg : 0.0);
+        }
+
+        if (!antialiasTimes.empty()) {
+            double antialiasTotal = std::accumulate(antialiasTimes.begin(), antialiasTimes.end(), 0.0);
+            double antialiasAvg = antialiasTotal / antialiasTimes.size();
+            printf("Antialias Stage (%dx%d): %.1fus/frame (%.1f%% of raster) | %llu edge cells/frame (%.1f%% of cells) | %.0fns/edge cell\n",
+                antialiasSamples, antialiasSamples, antialiasAvg / 1000.0, 100.0 * antialiasAvg / (rasterAvg ? rasterAvg : 1),
+                static_cast<unsigned long long>(edgeCells.total / antialiasTimes.size()),
+                100.0 * edgeCells.total / antialiasTimes.size() / (RASTER_WIDTH * RASTER_HEIGHT),
+                edgeCells.total ? antialiasTotal / edgeCells.total : 0.0);
+        }
+#endif
+    }
+}
+
+// Random turns among the first moveCount moves (cube::nxnMoveFace order, so layer by layer from
+// the outer face turns in), never turning layers of the same face twice in a row
+std::vector<int> randomMoveSequence(int moves, std::mt19937 &rng, int moveCount = cube::MOVE_COUNT) {
+    std::uniform_int_distribution<int> randomMove(0, moveCount - 1);
+    std::vector<int> sequence;
+
+    int previousFace = -1;
+    for (int n = 0; n < moves; n++) {
+        int move;
+        do {
+            move = randomMove(rng);
+        } while (cube::nxnMoveFace(move) == previousFace);
+
+        sequence.push_back(move);
+        previousFace = cube::nxnMoveFace(move);
+    }
+    return sequence;
+}
+
+// Layers up to the middle of the displayed cube; deeper ones repeat the same turns from the
+// opposite face
+int scrambleMoveCount() {
+    return std::max(cubeSize / 2, 1) * cube::FACE_ID_COUNT * 3;
+}
+
+const int SCRAMBLE_NOTATION_CAPACITY = 4096;
+
+// Moves from the solved cube to a uniformly random state: the inverse of its optimal solution on
+// the 2x2x2 (held by the DBL corner, so only U, R and F turn), of its two-phase solution otherwise
+std::vector<int> randomStateSequence(std::mt19937 &rng) {
+    cube::Solution solution = cubeSize == 2 ? cube::solvePocket(cube::randomPocketCubie(rng)) : cube::solveTwoPhase(cube::randomCubie(rng));
+    std::vector<int> sequence;
+    for (int i = solution.length - 1; i >= 0; i--) {
+        sequence.push_back(cube::inverseMove(solution.moves[i]));
+    }
+    return sequence;
+}
+
+// Returns the layer moves applied, empty for a random state set directly on the 3x3x3
+std::vector<int> scrambleCube(cube::NxnState &state, int moves) {
+    std::mt19937 rng(std::random_device{}());
+    std::vector<int> sequence;
+    if (scrambleNotation) {
+        std::vector<uint8_t> notation(SCRAMBLE_NOTATION_CAPACITY);
+        std::vector<uint8_t> layerMoves(SCRAMBLE_NOTATION_CAPACITY * cubeSize);
+        int count = cube::parseNotation(scrambleNotation, notation.data(), SCRAMBLE_NOTATION_CAPACITY);
+        count = cube::toLayerMoves(notation.data(), std::max(count, 0), cubeSize, layerMoves.data(), layerMoves.size());
+        sequence.assign(layerMoves.begin(), layerMoves.begin() + std::max(count, 0));
+    } else if (scrambleRandomState && cubeSize == 3) {
+        cube::CubeState random = cube::cubieToFacelet(cube::randomCubie(rng));
+        state.facelets.assign(random.facelets, random.facelets + cube::FACELET_COUNT);
+    } else if (scrambleRandomState && cubeSize == 2) {
+        sequence = randomStateSequence(rng);
+    } else {
+        sequence = randomMoveSequence(moves, rng, scrambleMoveCount());
+    }
+
+    for (int move : sequence) {
+        cube::applyMove(puzzle, state, move);
+    }
+    return sequence;
+}
+
+const int QUARTER_TURN_FRAMES = 8;
+const int HALF_TURN_FRAMES = 12;
+const int SOLVE_LOOP_PAUSE_FRAMES = 48; // idle frames after a sequence finishes
+
+std::vector<int> solveLoopMoves;
+size_t solveLoopNext = 0;
+int solveLoopPause = 0;
+bool solveLoopScrambled = false;
+std::vector<int> solveLoopScramble; // undone in reverse on cube sizes without a solver
+
+// A solve running on a worker thread while the frames keep animating. The thread is detached
+// and owns a reference, so exiting in the middle of a long optimal solve does not wait for it.
+struct PendingSolve {
+    std::atomic<bool> done{false};
+    cube::Solution solution;
+};
+std::shared_ptr<PendingSolve> pendingSolve;
+
+void startSolve(const cube::NxnState &state) {
+    std::shared_ptr<PendingSolve> pending = std::make_shared<PendingSolve>();
+    pendingSolve = pending;
+    int size = cubeSize;
+    bool optimal = solveOptimally;
+    std::thread([pending, state, size, optimal] {
+        if (size == 2) {
+            pending->solution = cube::solvePocket(state);
+        } else {
+            // --scramble slices and rotations leave the centers turned
+            cube::CubeState centered = cube::toCenteredCubeState(state);
+            pending->solution = optimal ? cube::solveOptimal(centered) : cube::solveTwoPhase(centered);
+        }
+        pending->done.store(true, std::memory_order_release);
+    }).detach();
+}
+
+// Advances the animated layer turn; the move is applied to the cube state on the frame after its
+// last turned frame. Returns false once no turn is in progress.
+bool stepLayerTurn(uint32_t frame) {
+    if (layerTurn.move < 0) {
+        return false;
+    }
+
+    int quarterTurns = layerTurn.move % 3 == 2 ? -1 : layerTurn.move % 3 + 1;
+    int frames = quarterTurns == 2 ? HALF_TURN_FRAMES : QUARTER_TURN_FRAMES;
+    uint32_t elapsed = frame - layerTurn.startFrame + 1;
+    if (elapsed > static_cast<uint32_t>(frames)) {
+        cube::applyMove(puzzle, cubeState, layerTurn.move);
+        layerTurn.move = -1;
+        return false;
+    }
+
+    // Eased in and out; cube::FaceId turns are clockwise about the outward normal in cube space,
+    // which is counterclockwise once the z axis is flipped into render space
+    float t = static_cast<float>(elapsed) / frames;
+    layerTurn.angle = quarterTurns * static_cast<float>(M_PI_2) * t * t * (3 - 2 * t);
+    return true;
+}
+
+// Alternates between playing a random scramble and the two-phase solution of the result, which
+// is searched on a worker thread while the cube keeps turning. The 2x2x2 is solved optimally
+// from its distance table; sizes above 3 play the scramble back inverted. Two-phase and 2x2x2
+// scrambles lead to a uniformly random state unless a scramble length was given.
+void stepSolveLoop(uint32_t frame) {
+    static std::mt19937 rng(std::random_device{}());
+    if (stepLayerTurn(frame)) {
+        return;
+    }
+
+    if (solveLoopNext < solveLoopMoves.size()) {
+        layerTurn.move = solveLoopMoves[solveLoopNext++];
+        layerTurn.startFrame = frame;
+        stepLayerTurn(frame);
+        return;
+    }
+    if (solveLoopPause > 0) {
+        solveLoopPause--;
+        return;
+    }
+    if (solveLoopScrambled && cubeSize <= 3 && !pendingSolve) {
+        startSolve(cubeState);
+    }
+    if (pendingSolve && !pendingSolve->done.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    solveLoopMoves.clear();
+    solveLoopNext = 0;
+    solveLoopPause = SOLVE_LOOP_PAUSE_FRAMES;
+    if (pendingSolve) {
+        const cube::Solution &solution = pendingSolve->solution;
+        solveLoopMoves.assign(solution.moves, solution.moves + std::max(solution.length, 0));
+        pendingSolve.reset();
+    } else if (solveLoopScrambled) {
+        for (auto move = solveLoopScramble.rbegin(); move != solveLoopScramble.rend(); ++move) {
+            solveLoopMoves.push_back(cube::inverseMove(*move));
+        }
+    } else if ((cubeSize == 2 || (cubeSize == 3 && !solveOptimally)) && !scrambleMoves) {
+        solveLoopMoves = randomStateSequence(rng);
+    } else {
+        // Optimal solves of deep scrambles take far longer than a pause between sequences
+        solveLoopMoves = randomMoveSequence(scrambleMoves ? scrambleMoves : (solveOptimally ? 10 : 20), rng, scrambleMoveCount());
+        solveLoopScramble = solveLoopMoves;
+    }
+    solveLoopScrambled = !solveLoopScrambled;
+}
+
+// Wall time of one call, for the benchmarks
+template <typename Fn>
+double seconds(Fn &&fn) {
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Each SSE kernel of vecmath against its scalar reference on random inputs: the reciprocal
+// square root (with the error of both against double precision) and the four point coverage
+// test, timed and checked to agree
+void runVecmathBenchmark() {
+    const int POINTS = 4096;
+    const int ROUNDS = 1024;
+    const int QUADS = 4096;
+    const double RSQRT_TOLERANCE = 1e-6; // relative, the refined estimate is good to ~23 bits
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(-static_cast<float>(M_PI), static_cast<float>(M_PI));
+
+    // Values spread over 2^-20 to 2^20
+    std::uniform_real_distribution<float> exponent(-20.0f, 20.0f);
+    std::vector<float> values(POINTS);
+    for (float &value : values) {
+        value = exp2f(exponent(rng));
+    }
+    volatile float sink = 0.0f;
+    double simdRsqrt = seconds([&] {
+        float sum = 0.0f;
+        for (int round = 0; round < ROUNDS; round++) {
+            for (float value : values) {
+                sum += vecmath::rsqrt(value);
+            }
+        }
+        sink = sum;
+    });
+    double scalarRsqrt = seconds([&] {
+        float sum = 0.0f;
+        for (int round = 0; round < ROUNDS; round++) {
+            for (float value : values) {
+                sum += vecmath::rsqrtScalar(value);
+            }
+        }
+        sink = sum;
+    });
+    double rsqrtError = 0.0, scalarRsqrtError = 0.0;
+    for (float value : values) {
+        double exact = 1.0 / sqrt(static_cast<double>(value));
+        rsqrtError = std::max(rsqrtError, fabs(vecmath::rsqrt(value) - exact) / exact);
+        scalarRsqrtError = std::max(scalarRsqrtError, fabs(vecmath::rsqrtScalar(value) - exact) / exact);
+    }
+    bool rsqrtAgree = rsqrtError <= RSQRT_TOLERANCE;
+
+    // Randomly rotated and placed squares as four inward facing edges, against points around them
+    struct Quad {
+        float a[4], b[4], c[4];
+    };
+    std::vector<Quad> quads(QUADS);
+    std::vector<float> px(QUADS * 4), py(QUADS * 4);
+    std::uniform_real_distribution<float> halfSize(0.5f, 4.0f);
+    for (int q = 0; q < QUADS; q++) {
+        float theta = angle(rng), size = halfSize(rng);
+        float cx = coordinate(rng), cy = coordinate(rng);
+        for (int e = 0; e < 4; e++) {
+            float nx = -cosf(theta + e * static_cast<float>(M_PI_2)), ny = -sinf(theta + e * static_cast<float>(M_PI_2));
+            quads[q].a[e] = nx;
+            quads[q].b[e] = ny;
+            quads[q].c[e] = size - nx * cx - ny * cy;
+        }
+        std::uniform_real_distribution<float> around(-2.0f * size, 2.0f * size);
+        for (int n = 0; n < 4; n++) {
+            px[q * 4 + n] = cx + around(rng);
+            py[q * 4 + n] = cy + around(rng);
+        }
+    }
+    std::vector<unsigned> simdMasks(QUADS), scalarMasks(QUADS);
+    double simdCoverage = seconds([&] {
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int q = 0; q < QUADS; q++) {
+                simdMasks[q] = vecmath::insideConvex4(quads[q].a, quads[q].b, quads[q].c, 4, &px[q * 4], &py[q * 4]);
+            }
+        }
+    });
+    double scalarCoverage = seconds([&] {
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int q = 0; q < QUADS; q++) {
+                scalarMasks[q] = vecmath::insideConvex4Scalar(quads[q].a, quads[q].b, quads[q].c, 4, &px[q * 4], &py[q * 4]);
+            }
+        }
+    });
+    int inside = 0;
+    for (unsigned mask : scalarMasks) {
+        inside += __builtin_popcount(mask);
+    }
+    bool coverageAgree = simdMasks == scalarMasks;
+
+    double calls = static_cast<double>(POINTS) * ROUNDS;
+    printf("vecmath (%s)\n", VECMATH_SSE ? "SSE" : "scalar fallback");
+    printf("rsqrt: %.1f Mcalls/s (scalar %.1f, %.2fx) | Max Relative Error: %.2g (scalar %.2g) | Results agree: %s\n",
+        calls / simdRsqrt / 1e6, calls / scalarRsqrt / 1e6, scalarRsqrt / simdRsqrt, rsqrtError, scalarRsqrtError,
+        rsqrtAgree ? "yes" : "NO");
+    printf("insideConvex4: %.1f Mtests/s (scalar %.1f, %.2fx) | %d of %d points inside | Results agree: %s\n",
+        static_cast<double>(QUADS) * ROUNDS / simdCoverage / 1e6, static_cast<double>(QUADS) * ROUNDS / scalarCoverage / 1e6,
+        scalarCoverage / simdCoverage, inside, QUADS * 4, coverageAgree ? "yes" : "NO");
+}
+
+// Applies the same random move sequence to a set of states with the scalar 54 byte tables, the
+// packed engine one state at a time and the packed engine in batches, and checks they agree
+void runMoveBenchmark() {
+    const int STATES = 4096;
+    const int ROUNDS = 2048;
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> randomMove(0, cube::MOVE_COUNT - 1);
+    std::vector<int> moves(ROUNDS);
+    for (int &move : moves) {
+        move = randomMove(rng);
+    }
+
+    std::vector<cube::CubeState> scalarStates(STATES, cube::solvedState());
+    std::vector<cube::PackedState> packedStates(STATES, cube::pack(cube::solvedState()));
+    std::vector<cube::PackedState> batchStates(STATES, cube::pack(cube::solvedState()));
+
+    auto measure = [&](auto &&applyRound) {
+        std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+        for (int round = 0; round < ROUNDS; round++) {
+            applyRound(moves[round]);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(STATES) * ROUNDS / seconds;
+    };
+
+    double scalarRate = measure([&](int move) {
+        for (cube::CubeState &state : scalarStates) {
+            cube::applyMove(state, move);
+        }
+    });
+    double packedRate = measure([&](int move) {
+        for (cube::PackedState &state : packedStates) {
+            cube::applyMove(state, move);
+        }
+    });
+    double batchRate = measure([&](int move) {
+        cube::applyMoveBatch(batchStates.data(), batchStates.size(), move);
+    });
+
+    bool agree = true;
+    for (int n = 0; n < STATES; n++) {
+        cube::CubeState packed = cube::unpack(packedStates[n]);
+        cube::CubeState batch = cube::unpack(batchStates[n]);
+        agree = agree && memcmp(packed.facelets, scalarStates[n].facelets, cube::FACELET_COUNT) == 0 &&
+                memcmp(batch.facelets, scalarStates[n].facelets, cube::FACELET_COUNT) == 0;
+    }
+
+    printf("Move Engine (%s): %d states x %d moves\n", CUBE_SSSE3 ? "SSSE3 pshufb" : "scalar fallback", STATES, ROUNDS);
+    printf("Scalar 54 byte tables: %.1f Mmoves/s\n", scalarRate / 1e6);
+    printf("Packed single: %.1f Mmoves/s (%.2fx) | Packed batch: %.1f Mmoves/s (%.2fx)\n",
+        packedRate / 1e6, packedRate / scalarRate, batchRate / 1e6, batchRate / scalarRate);
+    printf("Results agree: %s\n", agree ? "yes" : "NO");
+}
+
+// Every canonical sequence up to maxDepth, with the distinct positions per depth checked against
+// the known counts: a regression test and end to end benchmark of packed moves and state hashing
+void runPerftBenchmark(int maxDepth) {
+    cube::PositionSet set;
+    std::vector<cube::PerftLayer> layers = cube::perft(maxDepth, set);
+
+    uint64_t sequences = 0;
+    uint64_t positions = 0;
+    double seconds = 0.0;
+    bool known = true;
+    printf("Perft (%s moves, 64 bit state hashes)\n", CUBE_SSSE3 ? "SSSE3 pshufb" : "scalar fallback");
+    for (int depth = 0; depth <= maxDepth; depth++) {
+        const cube::PerftLayer &layer = layers[depth];
+        bool matches = layer.positions == cube::PERFT_POSITIONS[depth];
+        printf("Depth %d: %10llu sequences | %10llu positions (known: %s) | %8.1fms | %6.2f Msequences/s\n",
+            depth, static_cast<unsigned long long>(layer.sequences), static_cast<unsigned long long>(layer.positions),
+            matches ? "yes" : "NO", layer.seconds * 1000, layer.sequences / std::max(layer.seconds, 1e-9) / 1e6);
+        sequences += layer.sequences;
+        positions += layer.positions;
+        seconds += layer.seconds;
+        known = known && matches;
+    }
+
+    printf("Total: %llu sequences, %llu distinct positions | %.1fms | %.2f Msequences/s | Hash Set: %zu slots, %.2f load, %.2f probes/insert | Matches Known Counts: %s\n",
+        static_cast<unsigned long long>(sequences), static_cast<unsigned long long>(positions), seconds * 1000, sequences / seconds / 1e6,
+        set.slots.size(), static_cast<double>(set.size) / set.slots.size(), static_cast<double>(set.probes) / sequences, known ? "yes" : "NO");
+}
+
+// Move table build time single-threaded and on every core, cache load time, and the cost of
+// converting between facelets and coordinates
+void runCoordBenchmark() {
+    std::unique_ptr<cube::CoordMoveTables> tables(new cube::CoordMoveTables);
+    int threads = parallel::threadCount();
+    double singleBuild = seconds([&] { cube::buildCoordMoveTables(*tables, 1); });
+    double parallelBuild = seconds([&] { cube::buildCoordMoveTables(*tables, threads); });
+
+    cube::TableLoadStats stats;
+    const cube::CoordMoveTables &cached = cube::coordMoveTables(&stats);
+    bool matches = memcmp(&cached, tables.get(), sizeof(cube::CoordMoveTables)) == 0;
+    double load = seconds([&] {
+        tablecache::readTable("coord-move-tables.bin", cube::COORD_MOVE_TABLES_VERSION, tables.get(), sizeof(cube::CoordMoveTables));
+    });
+
+    printf("Coordinate Move Tables: %zu bytes | Build: %.1fms (1 thread), %.1fms (%d threads) | Cache Load: %.2fms | Matches Cache: %s\n",
+        sizeof(cube::CoordMoveTables), singleBuild * 1000, parallelBuild * 1000, threads, load * 1000, matches ? "yes" : "NO");
+
+    // Random states by random moves, tracked through the move tables at the same time
+    const int STATES = 100000;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> randomMove(0, cube::MOVE_COUNT - 1);
+    std::vector<cube::CubeState> states(STATES);
+    std::vector<cube::CubieCube> cubies(STATES);
+    cube::CubeState state = cube::solvedState();
+    int twist = 0, flip = 0, slice = 0, cornerPerm = 0;
+    bool tracked = true;
+    for (int n = 0; n < STATES; n++) {
+        int move = randomMove(rng);
+        cube::applyMove(state, move);
+        twist = cached.twist[twist][move];
+        flip = cached.flip[flip][move];
+        slice = cached.slice[slice][move];
+        cornerPerm = cached.cornerPerm[cornerPerm][move];
+        states[n] = state;
+
+        cube::CubieCube c;
+        tracked = tracked && cube::faceletToCubie(state, c) && cube::getTwist(c) == twist && cube::getFlip(c) == flip &&
+                  cube::getSlice(c) == slice && cube::getCornerPerm(c) == cornerPerm;
+    }
+
+    uint32_t checksum = 0;
+    double toCoords = seconds([&] {
+        for (int n = 0; n < STATES; n++) {
+            cube::faceletToCubie(states[n], cubies[n]);
+            checksum += cube::getTwist(cubies[n]) + cube::getFlip(cubies[n]) + cube::getSlice(cubies[n]) + cube::getCornerPerm(cubies[n]);
+        }
+    });
+
+    bool roundTrip = true;
+    double toFacelets = seconds([&] {
+        for (int n = 0; n < STATES; n++) {
+            cube::CubeState back = cube::cubieToFacelet(cubies[n]);
+            roundTrip = roundTrip && memcmp(back.facelets, states[n].facelets, cube::FACELET_COUNT) == 0;
+        }
+    });
+
+    printf("Facelets -> Cubies + Phase 1 Coordinates: %.0fns | Cubies -> Facelets: %.0fns | Move Tables Track Facelets: %s | Round Trip: %s (checksum %u)\n",
+        toCoords * 1e9 / STATES, toFacelets * 1e9 / STATES, tracked ? "yes" : "NO", roundTrip ? "yes" : "NO", checksum);
+}
+
+// Pruning table generation single-threaded and on every core, then two-phase solve times of
+// random scrambles, each solution checked by applying it to the facelets
+void runSolveBenchmark(int scrambles) {
+    cube::TableLoadStats stats;
+    const cube::PruneTables &tables = cube::pruneTables(&stats);
+    const cube::CoordMoveTables &moves = cube::coordMoveTables();
+
+    std::vector<uint64_t> words(cube::PRUNE_TABLES_BYTES / sizeof(uint64_t));
+    int threads = parallel::threadCount();
+    double singleBuild = seconds([&] { cube::generatePruneTables(words.data(), moves, cube::symmetryTables(), 1); });
+    double parallelBuild = seconds([&] { cube::generatePruneTables(words.data(), moves, cube::symmetryTables(), threads); });
+    bool matches = memcmp(words.data(), tables.table[0], cube::PRUNE_TABLES_BYTES) == 0;
+
+    printf("Pruning Tables: %llu bytes | %s: %.1fms | Generate: %.1fms (1 thread), %.1fms (%d threads) | Matches: %s\n",
+        static_cast<unsigned long long>(cube::PRUNE_TABLES_BYTES), stats.fromCache ? "Mapped" : "Generated",
+        stats.seconds * 1000, singleBuild * 1000, parallelBuild * 1000, threads, matches ? "yes" : "NO");
+
+    std::mt19937 rng(1);
+    std::vector<double> times;
+    int totalLength = 0;
+    int longest = 0;
+    bool solved = true;
+    for (int n = 0; n < scrambles; n++) {
+        cube::CubeState state = cube::solvedState();
+        for (int move : randomMoveSequence(30, rng)) {
+            cube::applyMove(state, move);
+        }
+
+        cube::Solution solution;
+        times.push_back(seconds([&] { solution = cube::solveTwoPhase(state); }));
+        for (int i = 0; i < solution.length; i++) {
+            cube::applyMove(state, solution.moves[i]);
+        }
+        solved = solved && solution.length >= 0 && cube::isSolved(state);
+        totalLength += solution.length;
+        longest = std::max(longest, solution.length);
+    }
+
+    std::sort(times.begin(), times.end());
+    printf("Two-Phase Solve: %d scrambles | p50: %.2fms | p99: %.2fms | Max: %.2fms | Avg Length: %.2f | Longest: %d | All Solved: %s\n",
+        scrambles, times[times.size() / 2] * 1000, times[times.size() * 99 / 100] * 1000, times.back() * 1000,
+        static_cast<double>(totalLength) / scrambles, longest, solved ? "yes" : "NO");
+}
+
+// Uniformly random states: generation throughput, a solvability check of every state, a
+// chi-squared test of the coordinates against uniform and the two-phase solves that turn a
+// state into an animation sequence
+void runScrambleBenchmark(int states) {
+    const int SOLVES = 200;
+
+    std::mt19937 rng(1);
+    std::vector<cube::CubieCube> cubies(states);
+    double generate = seconds([&] {
+        for (cube::CubieCube &c : cubies) {
+            c = cube::randomCubie(rng);
+        }
+    });
+
+    volatile uint8_t sink = 0; // keeps the conversions from being optimized out
+    double convert = seconds([&] {
+        for (const cube::CubieCube &c : cubies) {
+            sink = cube::cubieToFacelet(c).facelets[sink % cube::FACELET_COUNT];
+        }
+    });
+
+    bool solvable = true;
+    for (const cube::CubieCube &c : cubies) {
+        cube::CubieCube back;
+        solvable = solvable && cube::isSolvable(c) && cube::faceletToCubie(cube::cubieToFacelet(c), back) && memcmp(&back, &c, sizeof(c)) == 0;
+    }
+
+    printf("Random States: %d | Generate: %.1fns/state (%.2fM states/s) | To Facelets: %.1fns/state | All Solvable: %s\n",
+        states, generate * 1e9 / states, states / generate / 1e6, convert * 1e9 / states, solvable ? "yes" : "NO");
+
+    // For uniform counts z = (chi2 - dof) / sqrt(2 dof) is close to standard normal
+    struct Coordinate {
+        const char *name;
+        int count;
+        int (*get)(const cube::CubieCube &);
+    };
+    const Coordinate coordinates[] = {
+        {"Corner Perm", cube::CORNER_PERM_COUNT, cube::getCornerPerm},
+        {"Twist", cube::TWIST_COUNT, cube::getTwist},
+        {"Flip", cube::FLIP_COUNT, cube::getFlip},
+        {"Slice", cube::SLICE_COUNT, cube::getSlice},
+        {"Slice Order", cube::SLICE_PERM_COUNT, cube::getSlicePerm},
+        {"UR Position", cube::EDGE_COUNT, [](const cube::CubieCube &c) {
+            return static_cast<int>(std::find(c.ep, c.ep + cube::EDGE_COUNT, cube::EDGE_UR) - c.ep);
+        }},
+        {"Parity", 2, [](const cube::CubieCube &c) { return cube::permutationParity(c.cp, cube::CORNER_COUNT); }},
+    };
+
+    printf("Uniformity (chi-squared z):");
+    bool uniform = true;
+    for (const Coordinate &coordinate : coordinates) {
+        std::vector<int> counts(coordinate.count);
+        for (const cube::CubieCube &c : cubies) {
+            counts[coordinate.get(c)]++;
+        }
+
+        double expected = static_cast<double>(states) / coordinate.count;
+        double chi2 = 0;
+        for (int count : counts) {
+            chi2 += (count - expected) * (count - expected) / expected;
+        }
+        int dof = coordinate.count - 1;
+        double z = (chi2 - dof) / sqrt(2.0 * dof);
+        uniform = uniform && fabs(z) < 4;
+        printf(" %s %.2f |", coordinate.name, z);
+    }
+    printf(" Uniform: %s%s\n", uniform ? "yes" : "NO", states / cube::CORNER_PERM_COUNT < 5 ? " (too few states for the corner test)" : "");
+
+    std::vector<double> times;
+    int totalLength = 0;
+    bool solved = true;
+    for (int n = 0; n < std::min(states, SOLVES); n++) {
+        cube::CubeState state = cube::cubieToFacelet(cubies[n]);
+        cube::Solution solution;
+        times.push_back(seconds([&] { solution = cube::solveTwoPhase(state); }));
+        for (int i = 0; i < solution.length; i++) {
+            cube::applyMove(state, solution.moves[i]);
+        }
+        solved = solved && solution.length >= 0 && cube::isSolved(state);
+        totalLength += solution.length;
+    }
+
+    std::sort(times.begin(), times.end());
+    printf("Two-Phase Solve: %zu states | p50: %.2fms | p99: %.2fms | Avg Length: %.2f | All Solved: %s\n",
+        times.size(), times[times.size() / 2] * 1000, times[times.size() * 99 / 100] * 1000,
+        static_cast<double>(totalLength) / times.size(), solved ? "yes" : "NO");
+}
+
+// Parses, converts and canonicalizes random notation sequences (face, wide, slice and rotation
+// turns and repeated groups), reporting sequences/sec for each stage. A sample is checked: the
+// text round trips through formatNotation, the face turns plus the sequence's rotations match
+// the notation replayed layer by layer, and canonicalizing keeps the state, is idempotent and
+// leaves no mergeable neighbours.
+void runNotationBenchmark(int sequences) {
+    const int TOKENS = 20;
+    const int CAPACITY = 256;
+    const int CHECKED = 10000;
+
+    std::mt19937 rng(1);
+    std::string corpus;
+    std::vector<size_t> offsets;
+    const char *letters[] = {"U", "R", "F", "D", "L", "B", "Uw", "r", "Fw", "d", "M", "E", "S", "x", "y", "z"};
+    const char *suffixes[] = {"", "", "2", "'"};
+    const char *groupSuffixes[] = {"", "2", "'", "3"};
+    for (int n = 0; n < sequences; n++) {
+        offsets.push_back(corpus.size());
+        bool group = false;
+        for (int t = 0; t < TOKENS; t++) {
+            if (!group && rng() % 16 == 0) {
+                corpus += '(';
+                group = true;
+            }
+            int letter = rng() % 10 < 7 ? rng() % 6 : 6 + rng() % 10;
+            corpus += letters[letter];
+            corpus += suffixes[rng() % 4];
+            if (group && rng() % 4 == 0) {
+                corpus += ')';
+                corpus += groupSuffixes[rng() % 4];
+                group = false;
+            }
+            corpus += ' ';
+        }
+        if (group) {
+            corpus += ')';
+        }
+        corpus += '\0';
+    }
+
+    uint8_t notation[CAPACITY], faceTurns[CAPACITY * 2];
+    uint64_t moves = 0, turns = 0, kept = 0;
+    bool parsed = true;
+    double parse = seconds([&] {
+        for (size_t offset : offsets) {
+            int count = cube::parseNotation(corpus.data() + offset, notation, CAPACITY);
+            parsed = parsed && count >= 0;
+            moves += count;
+        }
+    });
+    double pipeline = seconds([&] {
+        for (size_t offset : offsets) {
+            int count = cube::parseNotation(corpus.data() + offset, notation, CAPACITY);
+            count = cube::toFaceTurns(notation, count, faceTurns, CAPACITY * 2);
+            turns += count;
+            kept += cube::canonicalizeMoves(faceTurns, count);
+        }
+    });
+
+    printf("Notation: %d sequences | %.1f chars, %.1f moves, %.1f face turns, %.1f canonical each | All Parsed: %s\n",
+        sequences, static_cast<double>(corpus.size()) / sequences - 1, static_cast<double>(moves) / sequences,
+        static_cast<double>(turns) / sequences, static_cast<double>(kept) / sequences, parsed ? "yes" : "NO");
+    printf("Parse: %.2fM sequences/s (%.0f MB/s, %.1fns/move) | Parse + Face Turns + Canonicalize: %.2fM sequences/s\n",
+        sequences / parse / 1e6, corpus.size() / parse / 1e6, parse * 1e9 / moves, sequences / pipeline / 1e6);
+
+    cube::NxnPuzzle puzzle = cube::buildNxnPuzzle(3);
+    bool roundTrip = true, replay = true, solvable = true, canonical = true;
+    for (int n = 0; n < std::min(sequences, CHECKED); n++) {
+        int count = cube::parseNotation(corpus.data() + offsets[n], notation, CAPACITY);
+
+        char text[CAPACITY * 4];
+        uint8_t reparsed[CAPACITY];
+        cube::formatNotation(notation, count, text, sizeof(text));
+        roundTrip = roundTrip && cube::parseNotation(text, reparsed, CAPACITY) == count && memcmp(reparsed, notation, count) == 0;
+
+        // Layer by layer against face turns followed by the rotations, including the one in every
+        // wide and slice turn, on a 3x3x3 with moving centers
+        uint8_t rotations[CAPACITY], layerMoves[CAPACITY * 3];
+        int rotationCount = 0;
+        for (int i = 0; i < count; i++) {
+            if (cube::notationKind(notation[i]) != cube::MOVE_KIND_FACE) {
+                rotations[rotationCount++] = cube::notationMove(cube::MOVE_KIND_ROTATION, cube::notationFace(notation[i]), cube::moveQuarterTurns(notation[i]));
+            }
+        }
+        cube::NxnState expected = cube::nxnSolvedState(puzzle), actual = expected;
+        int layerCount = cube::toLayerMoves(notation, count, 3, layerMoves, CAPACITY * 3);
+        for (int i = 0; i < layerCount; i++) {
+            cube::applyMove(puzzle, expected, layerMoves[i]);
+        }
+        int turnCount = cube::toFaceTurns(notation, count, faceTurns, CAPACITY * 2);
+        for (int i = 0; i < turnCount; i++) {
+            cube::applyMove(puzzle, actual, faceTurns[i]);
+        }
+        layerCount = cube::toLayerMoves(rotations, rotationCount, 3, layerMoves, CAPACITY * 3);
+        for (int i = 0; i < layerCount; i++) {
+            cube::applyMove(puzzle, actual, layerMoves[i]);
+        }
+        replay = replay && expected.facelets == actual.facelets;
+
+        // Slices and rotations turn the centers, which the solvers only read once they are home
+        cube::CubieCube cubies;
+        cube::CubeState centered = cube::toCenteredCubeState(expected);
+        solvable = solvable && cube::faceletToCubie(centered, cubies) && cube::isSolvable(cubies);
+
+        cube::CubeState before = cube::solvedState(), after = cube::solvedState();
+        for (int i = 0; i < turnCount; i++) {
+            cube::applyMove(before, faceTurns[i]);
+        }
+        int keptCount = cube::canonicalizeMoves(faceTurns, turnCount);
+        for (int i = 0; i < keptCount; i++) {
+            cube::applyMove(after, faceTurns[i]);
+            if (i > 0) {
+                int face = cube::moveFace(faceTurns[i]), previous = cube::moveFace(faceTurns[i - 1]);
+                canonical = canonical && face != previous && !(face == cube::oppositeFace(previous) && face < previous);
+            }
+        }
+        canonical = canonical && memcmp(before.facelets, after.facelets, cube::FACELET_COUNT) == 0 &&
+                    cube::canonicalizeMoves(faceTurns, keptCount) == keptCount;
+    }
+
+    printf("Checked %d: Round Trip: %s | Face Turns Match Layers: %s | Centered Layers Solvable: %s | Canonical Keeps State: %s\n",
+        std::min(sequences, CHECKED), roundTrip ? "yes" : "NO", replay ? "yes" : "NO", solvable ? "yes" : "NO", canonical ? "yes" : "NO");
+}
+
+// Optimal solves of random scrambles of the given length on 1, 2, 4, ... up to every core,
+// reporting IDA* nodes/sec and the speedup over one thread
+void runOptimalBenchmark(int scrambleLength) {
+    const int SCRAMBLES = 10;
+
+    cube::TableLoadStats stats;
+    cube::patternDatabases(&stats);
+    if (stats.fromCache) {
+        printf("Pattern Databases: %llu bytes | Mapped: %.1fms\n", static_cast<unsigned long long>(cube::PATTERN_DATABASES_BYTES), stats.seconds * 1000);
+    } else {
+        printf("Pattern Databases: %llu bytes | Generated: %.1fms (%d threads)\n", static_cast<unsigned long long>(cube::PATTERN_DATABASES_BYTES),
+            stats.seconds * 1000, stats.threads);
+    }
+
+    std::mt19937 rng(1);
+    std::vector<cube::CubeState> scrambles(SCRAMBLES, cube::solvedState());
+    for (cube::CubeState &state : scrambles) {
+        for (int move : randomMoveSequence(scrambleLength, rng)) {
+            cube::applyMove(state, move);
+        }
+    }
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < parallel::threadCount(); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(parallel::threadCount());
+
+    std::vector<int> lengths;
+    double baseRate = 0.0;
+    for (int threads : threadCounts) {
+        uint64_t nodes = 0;
+        double seconds = 0.0;
+        bool solved = true;
+        int totalLength = 0;
+        for (int n = 0; n < SCRAMBLES; n++) {
+            cube::OptimalStats solveStats;
+            cube::Solution solution = cube::solveOptimal(scrambles[n], threads, &solveStats);
+            nodes += solveStats.nodes;
+            seconds += solveStats.seconds;
+
+            cube::CubeState state = scrambles[n];
+            for (int i = 0; i < solution.length; i++) {
+                cube::applyMove(state, solution.moves[i]);
+            }
+            solved = solved && solution.length >= 0 && solution.length <= scrambleLength && cube::isSolved(state);
+            if (threads == 1) {
+                lengths.push_back(solution.length);
+            } else {
+                solved = solved && solution.length == lengths[n];
+            }
+            totalLength += solution.length;
+        }
+
+        double rate = nodes / seconds;
+        baseRate = threads == 1 ? rate : baseRate;
+        printf("Optimal Solve (%2d threads): %d scrambles of %d moves | Avg Length: %.1f | %.1fms/solve | %.2f Mnodes/s (%.2fx) | Optimal + Solved: %s\n",
+            threads, SCRAMBLES, scrambleLength, static_cast<double>(totalLength) / SCRAMBLES, seconds * 1000 / SCRAMBLES,
+            rate / 1e6, rate / baseRate, solved ? "yes" : "NO");
+    }
+}
+
+// Every two-phase pruning table and pattern database generated on 1, 2, 4, ... threads: states
+// reached per second, the speedup over one thread, where the search turned backward, and a check
+// against the cached tables
+void runBfsBenchmark() {
+    const cube::CoordMoveTables &moves = cube::coordMoveTables();
+    const cube::SymmetryTables &sym = cube::symmetryTables();
+    const cube::PruneTables &prune = cube::pruneTables();
+    const cube::PatternDatabases &pdb = cube::patternDatabases();
+
+    // The pruning tables in order, then the corner and edge pattern databases
+    const int TABLE_COUNT = cube::PRUNE_TABLE_COUNT + cube::PDB_COUNT;
+    const char *NAMES[TABLE_COUNT] = {"Slice x Twist", "Flip x Slice", "Corner x Slice Perm", "U/D Edge x Slice Perm", "Corner Pattern", "Edge Pattern"};
+    auto generate = [&](int table, uint64_t *words, int threads, cube::DepthTableStats *stats) {
+        if (table < cube::PRUNE_TABLE_COUNT) {
+            cube::generatePruneTable(words, cube::pruneSpace(moves, sym, table), cube::PRUNE_ENTRIES[table], threads, stats);
+        } else if (table - cube::PRUNE_TABLE_COUNT == cube::PDB_CORNERS) {
+            cube::generateCornerDatabase(words, moves, sym, threads, stats);
+        } else {
+            cube::generateEdgeDatabase(words, threads, stats);
+        }
+    };
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < parallel::threadCount(); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(parallel::threadCount());
+
+    for (int table = 0; table < TABLE_COUNT; table++) {
+        bool isPrune = table < cube::PRUNE_TABLE_COUNT;
+        uint32_t wordCount = isPrune ? cube::pruneWords(table) : cube::pdbWords(table - cube::PRUNE_TABLE_COUNT);
+        const uint8_t *cached = isPrune ? prune.table[table] : pdb.table[table - cube::PRUNE_TABLE_COUNT];
+        std::vector<uint64_t> words(wordCount);
+
+        double baseRate = 0.0;
+        for (int threads : threadCounts) {
+            cube::DepthTableStats stats;
+            generate(table, words.data(), threads, &stats);
+            bool matches = memcmp(words.data(), cached, wordCount * sizeof(uint64_t)) == 0;
+
+            int backwardFrom = -1;
+            for (int depth = stats.depth; depth >= 0; depth--) {
+                backwardFrom = stats.backward[depth] ? depth : backwardFrom;
+            }
+
+            double rate = stats.states / stats.seconds;
+            baseRate = threads == 1 ? rate : baseRate;
+            printf("%-22s (%2d threads): %9llu states | Depth: %2d | %8.1fms | %6.2f Mstates/s (%.2fx) | Backward From Depth: %2d | Matches: %s\n",
+                NAMES[table], threads, static_cast<unsigned long long>(stats.states), stats.depth, stats.seconds * 1000,
+                rate / 1e6, rate / baseRate, backwardFrom, matches ? "yes" : "NO");
+        }
+    }
+}
+
+// Each symmetry reduced table against the full table it replaces: size, generation time on every
+// core, the cost of a lookup at random coordinates and a check of every full entry against the
+// reduced one. The two edge sets of the optimal solver share a single table, so the second set
+// is generated with a table of its own and checked against the F2 lookup at random cubes.
+void runSymmetryBenchmark() {
+    const int LOOKUPS = 1 << 22;
+
+    cube::SymmetryLoadStats symStats;
+    const cube::SymmetryTables &sym = cube::symmetryTables(&symStats);
+    const cube::CoordMoveTables &moves = cube::coordMoveTables();
+    int threads = parallel::threadCount();
+    printf("Symmetry Tables: %zu bytes | Build: %.1fms | Classes: %d slice, %d corner perm, %d U/D edge perm | Counts Match: %s\n",
+        sizeof(cube::SymmetryTables), symStats.seconds * 1000, cube::SLICE_CLASS_COUNT, cube::CORNER_PERM_CLASS_COUNT,
+        cube::UD_EDGE_PERM_CLASS_COUNT, symStats.classCountsMatch ? "yes" : "NO");
+
+    std::mt19937 rng(1);
+    auto report = [&](const char *name, uint32_t rawEntries, uint32_t entries, double rawGenerate, double generate,
+                      double rawLookup, double lookup, bool matches) {
+        printf("%-24s %9u -> %8u entries (%4.1fx) | Generate: %7.1fms -> %6.1fms | Lookup: %5.1fns -> %5.1fns | Matches: %s\n",
+            name, rawEntries, entries, static_cast<double>(rawEntries) / entries, rawGenerate * 1000, generate * 1000,
+            rawLookup * 1e9 / LOOKUPS, lookup * 1e9 / LOOKUPS, matches ? "yes" : "NO");
+    };
+
+    // Both spaces index (a, b) with the reduced coordinate as a, so their entries line up
+    const int REDUCED_TABLES[3] = {cube::PRUNE_TWIST_SLICE, cube::PRUNE_CORNER_SLICE_PERM, cube::PRUNE_UD_EDGE_SLICE_PERM};
+    const char *REDUCED_NAMES[3] = {"Slice x Twist:", "Corner x Slice Perm:", "U/D Edge x Slice Perm:"};
+    uint64_t rawBytes = cube::PRUNE_TABLES_BYTES;
+    for (int n = 0; n < 3; n++) {
+        cube::PruneSpace reduced = cube::pruneSpace(moves, sym, REDUCED_TABLES[n]);
+        cube::PruneSpace raw = {reduced.moveA, reduced.moveB, reduced.countB, reduced.phase2};
+        uint32_t countA = n == 0 ? cube::SLICE_COUNT : cube::CORNER_PERM_COUNT;
+        uint32_t rawEntries = countA * raw.countB;
+        uint32_t entries = cube::PRUNE_ENTRIES[REDUCED_TABLES[n]];
+        rawBytes += (rawEntries + 15) / 16 * 8 - (entries + 15) / 16 * 8;
+
+        std::vector<uint64_t> rawWords((rawEntries + 15) / 16);
+        std::vector<uint64_t> words((entries + 15) / 16);
+        double rawGenerate = seconds([&] { cube::generatePruneTable(rawWords.data(), raw, rawEntries, threads); });
+        double generate = seconds([&] { cube::generatePruneTable(words.data(), reduced, entries, threads); });
+        const uint8_t *rawTable = reinterpret_cast<const uint8_t *>(rawWords.data());
+        const uint8_t *table = reinterpret_cast<const uint8_t *>(words.data());
+
+        bool matches = true;
+        for (uint32_t index = 0; index < rawEntries; index++) {
+            matches = matches && cube::pruneDepth(rawTable, index) == cube::pruneDepth(table, reduced.index(index / raw.countB, index % raw.countB));
+        }
+
+        std::vector<uint32_t> coords(LOOKUPS);
+        for (uint32_t &coord : coords) {
+            coord = rng() % rawEntries;
+        }
+        volatile int sink = 0;
+        double rawLookup = seconds([&] {
+            int sum = 0;
+            for (uint32_t coord : coords) {
+                sum += cube::pruneDepth(rawTable, coord);
+            }
+            sink = sum;
+        });
+        double lookup = seconds([&] {
+            int sum = 0;
+            for (uint32_t coord : coords) {
+                sum += cube::pruneDepth(table, reduced.index(coord / raw.countB, coord % raw.countB));
+            }
+            sink = sum;
+        });
+        report(REDUCED_NAMES[n], rawEntries, entries, rawGenerate, generate, rawLookup, lookup, matches);
+    }
+    printf("Two-Phase Tables: %llu -> %llu bytes (%.1fx)\n", static_cast<unsigned long long>(rawBytes),
+        static_cast<unsigned long long>(cube::PRUNE_TABLES_BYTES), static_cast<double>(rawBytes) / cube::PRUNE_TABLES_BYTES);
+
+    // Corner pattern database, and the edge table that used to be generated once per edge set
+    uint32_t rawEntries = cube::CORNER_PERM_COUNT * cube::TWIST_COUNT;
+    uint32_t entries = cube::PDB_ENTRIES[cube::PDB_CORNERS];
+    std::vector<uint64_t> rawWords((rawEntries + 15) / 16);
+    std::vector<uint64_t> words(cube::pdbWords(cube::PDB_CORNERS));
+    double rawGenerate = seconds([&] {
+        cube::generateDepthTable(rawWords.data(), rawEntries, 0, [&](uint32_t index, auto &&visit) {
+            for (int move = 0; move < cube::MOVE_COUNT; move++) {
+                if (visit(moves.cornerPerm[index / cube::TWIST_COUNT][move] * cube::TWIST_COUNT + moves.twist[index % cube::TWIST_COUNT][move])) {
+                    return;
+                }
+            }
+        }, threads);
+    });
+    double generate = seconds([&] { cube::generateCornerDatabase(words.data(), moves, sym, threads); });
+    const uint8_t *rawTable = reinterpret_cast<const uint8_t *>(rawWords.data());
+    const uint8_t *table = reinterpret_cast<const uint8_t *>(words.data());
+
+    bool matches = true;
+    for (uint32_t index = 0; index < rawEntries; index++) {
+        matches = matches && cube::pruneDepth(rawTable, index) == cube::pruneDepth(table, cube::cornerPatternIndex(sym, index / cube::TWIST_COUNT, index % cube::TWIST_COUNT));
+    }
+
+    std::vector<uint32_t> coords(LOOKUPS);
+    for (uint32_t &coord : coords) {
+        coord = rng() % rawEntries;
+    }
+    volatile int sink = 0;
+    double rawLookup = seconds([&] {
+        int sum = 0;
+        for (uint32_t coord : coords) {
+            sum += cube::pruneDepth(rawTable, coord);
+        }
+        sink = sum;
+    });
+    double lookup = seconds([&] {
+        int sum = 0;
+        for (uint32_t coord : coords) {
+            sum += cube::pruneDepth(table, cube::cornerPatternIndex(sym, coord / cube::TWIST_COUNT, coord % cube::TWIST_COUNT));
+        }
+        sink = sum;
+    });
+    report("Corners:", rawEntries, entries, rawGenerate, generate, rawLookup, lookup, matches);
+    rawWords = std::vector<uint64_t>();
+
+    // The second edge set with a table of its own, as before the reduction, against the first
+    // set's table looked up on the F2 conjugate, at random cubes
+    uint8_t secondIds[cube::PATTERN_EDGES];
+    for (int k = 0; k < cube::PATTERN_EDGES; k++) {
+        secondIds[k] = cube::SYMMETRIES.sym[cube::SYM_F2].edge[cube::PATTERN_EDGE_IDS[k]];
+    }
+    std::vector<uint64_t> edgeWords(cube::pdbWords(cube::PDB_EDGES));
+    std::vector<uint64_t> secondWords(cube::pdbWords(cube::PDB_EDGES));
+    double edgeGenerate = seconds([&] { cube::generateEdgeDatabase(edgeWords.data(), threads); });
+    double secondGenerate = seconds([&] { cube::generateEdgeDatabase(secondWords.data(), threads, nullptr, secondIds); });
+    const uint8_t *edgeTable = reinterpret_cast<const uint8_t *>(edgeWords.data());
+    const uint8_t *secondTable = reinterpret_cast<const uint8_t *>(secondWords.data());
+
+    std::vector<uint32_t> secondIndices(LOOKUPS), sharedIndices(LOOKUPS);
+    for (int n = 0; n < LOOKUPS; n++) {
+        cube::CubieCube c = cube::randomCubie(rng);
+        uint8_t slots[cube::PATTERN_EDGES];
+        for (int i = 0; i < cube::EDGE_COUNT; i++) {
+            for (int k = 0; k < cube::PATTERN_EDGES; k++) {
+                if (c.ep[i] == secondIds[k]) {
+                    slots[k] = static_cast<uint8_t>(i * 2 + c.eo[i]);
+                }
+            }
+        }
+        secondIndices[n] = cube::edgePatternIndex(slots);
+        cube::edgePatternSlots(cube::conjugate(c, cube::SYMMETRIES.sym[cube::SYM_F2]), slots);
+        sharedIndices[n] = cube::edgePatternIndex(slots);
+    }
+    bool edgesMatch = true;
+    for (int n = 0; n < LOOKUPS; n++) {
+        edgesMatch = edgesMatch && cube::pruneDepth(secondTable, secondIndices[n]) == cube::pruneDepth(edgeTable, sharedIndices[n]);
+    }
+    volatile int edgeSink = 0;
+    double secondLookup = seconds([&] {
+        int sum = 0;
+        for (uint32_t index : secondIndices) {
+            sum += cube::pruneDepth(secondTable, index);
+        }
+        edgeSink = sum;
+    });
+    double sharedLookup = seconds([&] {
+        int sum = 0;
+        for (uint32_t index : sharedIndices) {
+            sum += cube::pruneDepth(edgeTable, index);
+        }
+        edgeSink = sum;
+    });
+    report("Edges (2 sets, 1 table):", 2 * cube::PDB_ENTRIES[cube::PDB_EDGES], cube::PDB_ENTRIES[cube::PDB_EDGES],
+        edgeGenerate + secondGenerate, edgeGenerate, secondLookup, sharedLookup, edgesMatch);
+    uint64_t rawPdbBytes = static_cast<uint64_t>((rawEntries + 15) / 16 + 2 * cube::pdbWords(cube::PDB_EDGES)) * sizeof(uint64_t);
+    printf("Pattern Databases: %llu -> %llu bytes (%.1fx)\n", static_cast<unsigned long long>(rawPdbBytes),
+        static_cast<unsigned long long>(cube::PATTERN_DATABASES_BYTES), static_cast<double>(rawPdbBytes) / cube::PATTERN_DATABASES_BYTES);
+}
+
+// The 2x2x2 distance table generated single-threaded and on every core, its cache load, the
+// number of states at each distance checked against the known counts, and optimal solves of
+// uniformly random states and of scrambles turning every face, each checked to solve the cube
+void runPocketBenchmark() {
+    const int SOLVES = 100000;
+    const int SCRAMBLE_LENGTH = 30;
+    // States at each distance in the half-turn metric, with the cube held by one corner
+    const uint64_t KNOWN_DISTANCES[cube::POCKET_MAX_DEPTH + 1] = {1, 9, 54, 321, 1847, 9992, 50136, 227536, 870072, 1887748, 623800, 2644};
+
+    std::vector<uint64_t> words(cube::POCKET_TABLE_BYTES / sizeof(uint64_t));
+    int threads = parallel::threadCount();
+    cube::DepthTableStats single;
+    cube::DepthTableStats stats;
+    cube::generatePocketTable(words.data(), 1, &single);
+    cube::generatePocketTable(words.data(), threads, &stats);
+
+    cube::TableLoadStats loadStats;
+    const uint8_t *table = cube::pocketTable(&loadStats);
+    bool matches = memcmp(table, words.data(), cube::POCKET_TABLE_BYTES) == 0;
+    double load = seconds([&] {
+        tablecache::readTable("pocket-distance-table.bin", cube::POCKET_TABLE_VERSION, words.data(), cube::POCKET_TABLE_BYTES);
+    });
+
+    printf("2x2x2 Distance Table: %u states, %llu bytes | Build: %.1fms (1 thread, %.1f Mstates/s), %.1fms (%d threads, %.1f Mstates/s) | Cache Load: %.2fms | Matches Cache: %s\n",
+        cube::POCKET_STATE_COUNT, static_cast<unsigned long long>(cube::POCKET_TABLE_BYTES), single.seconds * 1000,
+        single.states / single.seconds / 1e6, stats.seconds * 1000, threads, stats.states / stats.seconds / 1e6, load * 1000, matches ? "yes" : "NO");
+
+    bool known = stats.depth == cube::POCKET_MAX_DEPTH && stats.states == cube::POCKET_STATE_COUNT;
+    double averageDistance = 0.0;
+    for (int depth = 0; depth <= stats.depth; depth++) {
+        bool layerKnown = depth <= cube::POCKET_MAX_DEPTH && stats.layerStates[depth] == KNOWN_DISTANCES[depth];
+        printf("Distance %2d: %8llu states (%6.3f%%, known: %s)\n", depth, static_cast<unsigned long long>(stats.layerStates[depth]),
+            stats.layerStates[depth] * 100.0 / cube::POCKET_STATE_COUNT, layerKnown ? "yes" : "NO");
+        averageDistance += static_cast<double>(depth) * stats.layerStates[depth] / cube::POCKET_STATE_COUNT;
+        known = known && layerKnown;
+    }
+    printf("Distances Match Known Counts: %s | Average Distance: %.3f\n", known ? "yes" : "NO", averageDistance);
+
+    cube::NxnPuzzle pocket = cube::buildNxnPuzzle(2);
+    cube::NxnState solved = cube::nxnSolvedState(pocket);
+    auto isSolved = [](const cube::NxnState &state) {
+        for (size_t f = 0; f < state.facelets.size(); f++) {
+            if (state.facelets[f] != state.facelets[f / 4 * 4]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> randomMove(0, cube::MOVE_COUNT - 1);
+    for (int uniform = 1; uniform >= 0; uniform--) {
+        std::vector<cube::NxnState> states(SOLVES, solved);
+        for (cube::NxnState &state : states) {
+            if (uniform) {
+                cube::CubeState random = cube::cubieToFacelet(cube::randomPocketCubie(rng));
+                for (size_t f = 0; f < state.facelets.size(); f++) {
+                    int n = f % 4;
+                    state.facelets[f] = random.facelets[f / 4 * cube::FACELETS_PER_FACE + n / 2 * 6 + n % 2 * 2];
+                }
+            } else {
+                for (int n = 0; n < SCRAMBLE_LENGTH; n++) {
+                    cube::applyMove(pocket, state, randomMove(rng));
+                }
+            }
+        }
+
+        std::vector<cube::Solution> solutions(SOLVES);
+        double solve = seconds([&] {
+            for (int n = 0; n < SOLVES; n++) {
+                solutions[n] = cube::solvePocket(states[n]);
+            }
+        });
+
+        uint64_t moves = 0;
+        bool allSolved = true;
+        for (int n = 0; n < SOLVES; n++) {
+            for (int i = 0; i < solutions[n].length; i++) {
+                cube::applyMove(pocket, states[n], solutions[n].moves[i]);
+            }
+            moves += std::max(solutions[n].length, 0);
+            allSolved = allSolved && solutions[n].length >= 0 && isSolved(states[n]);
+        }
+        printf("%-30s %d solves | %.2fus/solve | Average Length: %.3f | All Solved: %s\n",
+            uniform ? "Uniformly Random States:" : "30 Turn Scrambles (all faces):", SOLVES, solve * 1e6 / SOLVES,
+            static_cast<double>(moves) / SOLVES, allSolved ? "yes" : "NO");
+    }
+}
+
+// Reads one scramble per line from stdin and writes its two-phase solution on the matching line
+// of stdout ("error" for lines that are not WCA notation). Slices and rotations are replayed as
+// face turns and the solution is named for the cube held as the scramble leaves it, so the
+// scramble followed by its solution always solves the cube. Lines are solved a block at a time on
+// every core and written in input order, so memory stays constant however long the input is.
+void runSolveBatch() {
+    const int BLOCK_LINES = 4096;
+    const int LINE_CAPACITY = 1024;
+    const int SCRAMBLE_CAPACITY = 256;
+
+    struct BatchLine {
+        uint8_t moves[SCRAMBLE_CAPACITY];
+        int count;
+        uint8_t orientation[cube::FACE_ID_COUNT]; // original face at each position afterwards
+        cube::Solution solution;
+    };
+
+    cube::TableLoadStats stats;
+    cube::pruneTables(&stats);
+
+    std::vector<BatchLine> block(BLOCK_LINES);
+    std::string out;
+    out.reserve(BLOCK_LINES * 64);
+    char line[LINE_CAPACITY];
+    uint8_t notation[SCRAMBLE_CAPACITY];
+
+    uint64_t lineCount = 0;
+    uint64_t errors = 0;
+    uint64_t totalLength = 0;
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+    for (bool more = true; more;) {
+        int lines = 0;
+        while (lines < BLOCK_LINES && fgets(line, sizeof(line), stdin)) {
+            size_t length = strlen(line);
+            if (length == 0) {
+                // Starts with a NUL byte, so not notation; the newline was read with it unless
+                // the line filled the buffer, and its remainder then shows as further error lines
+                block[lines++].count = -1;
+                continue;
+            }
+            if (line[length - 1] != '\n' && !feof(stdin)) {
+                // Longer than any scramble worth solving; skip the rest of it
+                int c;
+                while ((c = getchar()) != EOF && c != '\n') {}
+                block[lines++].count = -1;
+                continue;
+            }
+            int count = cube::parseNotation(line, notation, SCRAMBLE_CAPACITY);
+            count = count < 0 ? -1 : cube::toFaceTurns(notation, count, block[lines].moves, SCRAMBLE_CAPACITY, block[lines].orientation);
+            block[lines].count = count < 0 ? -1 : cube::canonicalizeMoves(block[lines].moves, count);
+            lines++;
+        }
+        more = lines == BLOCK_LINES;
+
+        parallel::parallelFor(0, lines, [&](size_t n) {
+            BatchLine &batchLine = block[n];
+            if (batchLine.count < 0) {
+                return;
+            }
+            cube::CubeState state = cube::solvedState();
+            for (int i = 0; i < batchLine.count; i++) {
+                cube::applyMove(state, batchLine.moves[i]);
+            }
+            batchLine.solution = cube::solveTwoPhase(state);
+        });
+
+        out.clear();
+        for (int n = 0; n < lines; n++) {
+            const BatchLine &batchLine = block[n];
+            if (batchLine.count < 0) {
+                out += "error";
+                errors++;
+            } else {
+                int positionOf[cube::FACE_ID_COUNT];
+                for (int position = 0; position < cube::FACE_ID_COUNT; position++) {
+                    positionOf[batchLine.orientation[position]] = position;
+                }
+                for (int i = 0; i < batchLine.solution.length; i++) {
+                    if (i) {
+                        out += ' ';
+                    }
+                    int move = batchLine.solution.moves[i];
+                    out += cube::MOVE_NAMES[positionOf[cube::moveFace(move)] * 3 + move % 3];
+                }
+                totalLength += batchLine.solution.length;
+            }
+            out += '\n';
+        }
+        fwrite(out.data(), 1, out.size(), stdout);
+        lineCount += lines;
+    }
+    fflush(stdout);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "Solve Batch: %llu lines | %llu errors | %.2fs on %d threads | %.1f solves/s | Avg Length: %.2f | Tables %s: %.1fms\n",
+        static_cast<unsigned long long>(lineCount), static_cast<unsigned long long>(errors), seconds, parallel::threadCount(),
+        (lineCount - errors) / seconds, lineCount > errors ? static_cast<double>(totalLength) / (lineCount - errors) : 0.0,
+        stats.fromCache ? "Mapped" : "Generated", stats.seconds * 1000);
+}
+
+void SIGINTCallbackEventHandler(int sigNum) {
+    handleExit();
+    exit(sigNum);
+}
+
+void SIGWINCHCallbackEventHandler(int sigNum) {
+    updateDim();
+}
+
+int main (int argc, char *argv[]) {
+    static uint8_t notation[SCRAMBLE_NOTATION_CAPACITY]; // --scramble text is checked by parsing it
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--overdraw") == 0) {
+            showOverdrawHeatmap = true;
+        } else if (strcmp(argv[arg], "--static-light") == 0) {
+            rotateLightSource = false;
+        } else if (strcmp(argv[arg], "--half-block") == 0) {
+            renderMode = RENDER_HALF_BLOCK;
+            rasterScale = {1, 2};
+        } else if (strcmp(argv[arg], "--braille") == 0) {
+            renderMode = RENDER_BRAILLE;
+            rasterScale = {2, 4};
+        } else if (strcmp(argv[arg], "--colors") == 0 && arg + 1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "256") == 0) {
+                colorMode = COLOR_MODE_256;
+            } else if (strcmp(argv[arg], "truecolor") == 0 || strcmp(argv[arg], "24bit") == 0) {
+                colorMode = COLOR_MODE_TRUECOLOR;
+            } else {
+                colorMode = COLOR_MODE_16;
+            }
+        } else if (strcmp(argv[arg], "--scramble") == 0) {
+            scrambleMoves = 20;
+            if (arg + 1 < argc && isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                scrambleMoves = atoi(argv[++arg]);
+            } else if (arg + 1 < argc && strcmp(argv[arg + 1], "random") == 0) {
+                scrambleMoves = 0;
+                scrambleRandomState = true;
+                arg++;
+            } else if (arg + 1 < argc && cube::parseNotation(argv[arg + 1], notation, SCRAMBLE_NOTATION_CAPACITY) >= 0) {
+                scrambleMoves = 0;
+                scrambleNotation = argv[++arg];
+            }
+        } else if (strcmp(argv[arg], "--size") == 0 && arg + 1 < argc) {
+            cubeSize = std::clamp(atoi(argv[++arg]), cube::NXN_MIN_SIZE, cube::NXN_MAX_SIZE);
+        } else if (strcmp(argv[arg], "--bench-vecmath") == 0) {
+            runVecmathBenchmark();
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-moves") == 0) {
+            runMoveBenchmark();
+            return 0;
+        } else if (strcmp(argv[arg], "--perft") == 0) {
+            int depth = 5;
+            if (arg + 1 < argc && isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                depth = std::clamp(atoi(argv[++arg]), 1, cube::PERFT_MAX_DEPTH);
+            }
+            runPerftBenchmark(depth);
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-coords") == 0) {
+            runCoordBenchmark();
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-solve") == 0) {
+            int scrambles = 1000;
+            if (arg + 1 < argc && isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                scrambles = std::max(1, atoi(argv[++arg]));
+            }
+            runSolveBenchmark(scrambles);
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-scramble") == 0) {
+            int states = 1000000;
+            if (arg + 1 < argc && isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                states = std::max(1, atoi(argv[++arg]));
+            }
+            runScrambleBenchmark(states);
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-notation") == 0) {
+            int sequences = 1000000;
+            if (arg + 1 < argc && isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                sequences = std::max(1, atoi(argv[++arg]));
+            }
+            runNotationBenchmark(sequences);
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-optimal") == 0) {
+            int scrambleLength = 12;
+            if (arg + 1 < argc && isdigit(static_cast<unsigned char>(argv[arg + 1][0]))) {
+                scrambleLength = std::max(1, atoi(argv[++arg]));
+            }
+            runOptimalBenchmark(scrambleLength);
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-bfs") == 0) {
+            runBfsBenchmark();
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-symmetry") == 0) {
+            runSymmetryBenchmark();
+            return 0;
+        } else if (strcmp(argv[arg], "--bench-pocket") == 0) {
+            runPocketBenchmark();
+            return 0;
+        } else if (strcmp(argv[arg], "--solve-batch") == 0) {
+            runSolveBatch();
+            return 0;
+        } else if (strcmp(argv[arg], "--solve") == 0) {
+            solveLoop = true;
+            if (arg + 1 < argc && strcmp(argv[arg + 1], "optimal") == 0) {
+                solveOptimally = true;
+                arg++;
+            }
+        } else if (strcmp(argv[arg], "--antialias") == 0) {
+            antialiasSamples = 2;
+            if (arg + 1 < argc && strcmp(argv[arg + 1], "4") == 0) {
+                antialiasSamples = 4;
+                arg++;
+            } else if (arg + 1 < argc && strcmp(argv[arg + 1], "2") == 0) {
+                arg++;
+            }
+        }
+    }
+
+    if (solveLoop && cubeSize == 2) {
+        cube::pocketTable();
+    } else if (solveLoop && cubeSize == 3) {
+        // Generated on the first run only (seconds for two-phase, longer for optimal), mapped afterwards
+        if (solveOptimally) {
+            cube::patternDatabases();
+        } else {
+            cube::pruneTables();
+        }
+    }
+
+    signal(SIGINT, SIGINTCallbackEventHandler);
+    signal(SIGWINCH, SIGWINCHCallbackEventHandler);
+
+    printf("%s", ANSI_escape_code::ENABLE_ALT_BUFFER);
+    printf("%s", ANSI_escape_code::ERASE_SCREEN);
+    printf("%s", ANSI_escape_code::CURSOR_INVISIBLE);
+
+    RASTER_WIDTH = WIDTH * rasterScale.w;
+    RASTER_HEIGHT = HEIGHT * rasterScale.h;
+    resizeBuffers(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer);
+    buildSgrTables(colorMode, renderMode == RENDER_ASCII);
+    puzzle = cube::buildNxnPuzzle(cubeSize);
+    cubeState = cube::nxnSolvedState(puzzle);
+    buildStickerFacelets();
+    // The solve loop scrambles from solved itself (--scramble n only sets the length), except
+    // that a notation scramble is solved first, or played back inverted on sizes above 3
+    if (!solveLoop || scrambleNotation) {
+        solveLoopScramble = scrambleCube(cubeState, scrambleMoves);
+        solveLoopScrambled = solveLoop;
+    }
+
+    buildFaceLattice(faceLattice);
+    updateDim();
+
+    frameTimes.reserve(5000);
+    lightingTimes.reserve(5000);
+    rasterTimes.reserve(5000);
+    antialiasTimes.reserve(5000);
+    turnRasterTimes.reserve(5000);
+
+    float A = -M_PI_2; // Axis facing the screen (z-axis)
+    float B = -M_PI_2; // Up / Down axis (y-axis)
+    float C = M_PI_2 + M_PI_4; // Left / Right axis (x-axis)
+
+    // Per-frame steps of A, B and C
+    cubeOrientation = vecmath::quatFromEuler(A, B, C);
+    cubeWorldDelta = vecmath::quatFromAxisAngle({0.0f, 0.0f, 1.0f}, 0.03f);
+    cubeBodyDelta = vecmath::quatFromEuler(0.0f, 0.02f, 0.01f);
+    rotation = vecmath::toMat3(cubeOrientation);
+
+    float D = 0.0f;
+    float E = 0.0f;
+    float F = 0.0f;
+
+    // Per-frame steps of D, E and F
+    lightOrientation = vecmath::quatFromEuler(D, E, F);
+    lightWorldDelta = vecmath::quatFromAxisAngle({0.0f, 0.0f, 1.0f}, 0.01f);
+    lightBodyDelta = vecmath::quatFromEuler(0.0f, 0.01f, 0.01f);
+
+    nextFrame = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::steady_clock::now());
+    previousFrame = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::steady_clock::now());
+
+    for (uint32_t frame = 1; ; frame++) {
+        PROFILE_SCOPE(frameTimes);
+
+        stepOrientation(cubeOrientation, cubeWorldDelta, cubeBodyDelta, frame);
+        rotation = vecmath::toMat3(cubeOrientation);
+
+        if (solveLoop) {
+            stepSolveLoop(frame);
+        }
+
+        /* Rotate Light Source */
+        if (rotateLightSource) {
+            stepOrientation(lightOrientation, lightWorldDelta, lightBodyDelta, frame);
+        }
+
+        renderFrame(buffer, buffer_prev, cbuffer, cbuffer_prev, zbuffer, rotation);
 
         if (FPS_LIMIT != 0.0f) {
             std::this_thread::sleep_until(nextFrame);
@@ -0,0 +1,368 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// WCA move notation: face turns, wide turns, slices, rotations and repeated groups parsed into
+// one byte per move without allocating, plus the conversions the engines need (face turns for
+// the 3x3x3 solvers, layer moves for N x N x N cubes) and a canonicalizer that cancels and
+// merges neighbouring moves.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <initializer_list>
+
+#include "cube.hpp"
+#include "nxn.hpp"
+
+namespace cube {
+    enum MoveKind {
+        MOVE_KIND_FACE,     // R
+        MOVE_KIND_WIDE,     // Rw or r: the face and the middle layer
+        MOVE_KIND_SLICE,    // M, E, S: the middle layer, turning like L, D and F
+        MOVE_KIND_ROTATION, // x, y, z: the whole cube, turning like R, U and F
+        MOVE_KIND_COUNT
+    };
+
+    // Notation moves extend the face turns: move = (kind * 6 + face) * 3 + quarter turns - 1, so
+    // the first MOVE_COUNT are the MOVE_NAMES moves and inverseMove works on all of them
+    constexpr int NOTATION_MOVE_COUNT = MOVE_KIND_COUNT * MOVE_COUNT;
+    constexpr int NOTATION_MAX_DEPTH = 8; // nested groups
+
+    constexpr int notationMove(int kind, int face, int quarterTurns) { return (kind * FACE_ID_COUNT + face) * 3 + quarterTurns - 1; }
+    constexpr int notationKind(int move) { return move / MOVE_COUNT; }
+    constexpr int notationFace(int move) { return move / 3 % FACE_ID_COUNT; }
+    constexpr int moveQuarterTurns(int move) { return move % 3 + 1; }
+    constexpr int oppositeFace(int face) { return (face + 3) % FACE_ID_COUNT; }
+
+    // Slices and rotations turning like the other face of their axis are the inverse turn
+    inline const char *NOTATION_NAMES[NOTATION_MOVE_COUNT] = {
+        "U", "U2", "U'", "R", "R2", "R'", "F", "F2", "F'", "D", "D2", "D'", "L", "L2", "L'", "B", "B2", "B'",
+        "Uw", "Uw2", "Uw'", "Rw", "Rw2", "Rw'", "Fw", "Fw2", "Fw'", "Dw", "Dw2", "Dw'", "Lw", "Lw2", "Lw'", "Bw", "Bw2", "Bw'",
+        "E'", "E2", "E", "M'", "M2", "M", "S", "S2", "S'", "E", "E2", "E'", "M", "M2", "M'", "S'", "S2", "S",
+        "y", "y2", "y'", "x", "x2", "x'", "z", "z2", "z'", "y'", "y2", "y", "x'", "x2", "x", "z'", "z2", "z"
+    };
+
+    // The parser only produces slices about L, D, F and rotations about R, U, F
+    constexpr int canonicalMove(int move) {
+        int kind = notationKind(move), face = notationFace(move);
+        bool other = (kind == MOVE_KIND_SLICE && (face == FACE_U || face == FACE_R || face == FACE_B)) ||
+                     (kind == MOVE_KIND_ROTATION && (face == FACE_D || face == FACE_L || face == FACE_B));
+        return other ? notationMove(kind, oppositeFace(face), 4 - moveQuarterTurns(move)) : move;
+    }
+
+    // Move letters as 1 + kind * 6 + face, 0 for anything else
+    struct NotationLetters {
+        uint8_t code[128];
+    };
+
+    constexpr NotationLetters buildNotationLetters() {
+        NotationLetters letters{};
+        const char faces[] = "URFDLB";
+        const char wide[] = "urfdlb";
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            letters.code[static_cast<int>(faces[face])] = 1 + MOVE_KIND_FACE * FACE_ID_COUNT + face;
+            letters.code[static_cast<int>(wide[face])] = 1 + MOVE_KIND_WIDE * FACE_ID_COUNT + face;
+        }
+        letters.code['M'] = 1 + MOVE_KIND_SLICE * FACE_ID_COUNT + FACE_L;
+        letters.code['E'] = 1 + MOVE_KIND_SLICE * FACE_ID_COUNT + FACE_D;
+        letters.code['S'] = 1 + MOVE_KIND_SLICE * FACE_ID_COUNT + FACE_F;
+        letters.code['x'] = 1 + MOVE_KIND_ROTATION * FACE_ID_COUNT + FACE_R;
+        letters.code['y'] = 1 + MOVE_KIND_ROTATION * FACE_ID_COUNT + FACE_U;
+        letters.code['z'] = 1 + MOVE_KIND_ROTATION * FACE_ID_COUNT + FACE_F;
+        return letters;
+    }
+
+    inline constexpr NotationLetters NOTATION_LETTERS = buildNotationLetters();
+
+    // Parses notation such as "R U' F2", "Rw r2 M' x y2", "(R U R' U')3" or "(R U)'" into
+    // notation moves. A turn takes any count ("R3" is R', "R2'" is R2) and tokens need no spaces
+    // between them; a group is repeated by its count and inverted by a prime. Returns the number
+    // of moves, or -1 for anything else, more than capacity moves or groups nested deeper than
+    // NOTATION_MAX_DEPTH.
+    inline int parseNotation(const char *text, uint8_t *moves, int capacity) {
+        int groupStart[NOTATION_MAX_DEPTH];
+        int depth = 0;
+        int count = 0;
+        for (const char *c = text; *c;) {
+            unsigned char letter = *c++;
+            if (letter == ' ' || letter == '\t' || letter == '\n' || letter == '\r') {
+                continue;
+            }
+
+            if (letter == '(') {
+                if (depth == NOTATION_MAX_DEPTH) {
+                    return -1;
+                }
+                groupStart[depth++] = count;
+                continue;
+            }
+
+            if (letter == ')') {
+                if (depth == 0) {
+                    return -1;
+                }
+                int start = groupStart[--depth];
+                int length = count - start;
+
+                int repeat = 1;
+                if (*c >= '0' && *c <= '9') {
+                    repeat = 0;
+                    while (*c >= '0' && *c <= '9') {
+                        repeat = std::min(repeat * 10 + (*c++ - '0'), capacity + 1);
+                    }
+                }
+                if (*c == '\'') {
+                    c++;
+                    for (int i = start, j = count - 1; i <= j; i++, j--) {
+                        uint8_t first = moves[i];
+                        moves[i] = inverseMove(moves[j]);
+                        moves[j] = inverseMove(first);
+                    }
+                }
+
+                if (repeat == 0) {
+                    count = start;
+                    continue;
+                }
+                if (length > 0 && repeat > (capacity - start) / length) {
+                    return -1;
+                }
+                for (int r = 1; r < repeat; r++) {
+                    for (int i = 0; i < length; i++) {
+                        moves[count++] = moves[start + i];
+                    }
+                }
+                continue;
+            }
+
+            int code = letter < 128 ? NOTATION_LETTERS.code[letter] : 0;
+            if (!code) {
+                return -1;
+            }
+            int kind = (code - 1) / FACE_ID_COUNT;
+            int face = (code - 1) % FACE_ID_COUNT;
+            if (kind == MOVE_KIND_FACE && *c == 'w') {
+                kind = MOVE_KIND_WIDE;
+                c++;
+            }
+
+            // Only the count mod 4 matters, so it never overflows
+            int quarterTurns = 1;
+            if (*c >= '0' && *c <= '9') {
+                quarterTurns = 0;
+                while (*c >= '0' && *c <= '9') {
+                    quarterTurns = (quarterTurns * 10 + (*c++ - '0')) % 4;
+                }
+            }
+            if (*c == '\'') {
+                quarterTurns = (4 - quarterTurns) % 4;
+                c++;
+            }
+
+            if (quarterTurns == 0) {
+                continue;
+            }
+            if (count == capacity) {
+                return -1;
+            }
+            moves[count++] = notationMove(kind, face, quarterTurns);
+        }
+        return depth == 0 ? count : -1;
+    }
+
+    // Moves separated by single spaces and null terminated; the length written, or -1 if it
+    // does not fit in capacity bytes
+    inline int formatNotation(const uint8_t *moves, int count, char *text, int capacity) {
+        int length = 0;
+        for (int i = 0; i < count; i++) {
+            const char *name = NOTATION_NAMES[moves[i]];
+            if (i > 0) {
+                if (length + 1 >= capacity) {
+                    return -1;
+                }
+                text[length++] = ' ';
+            }
+            for (; *name; name++) {
+                if (length + 1 >= capacity) {
+                    return -1;
+                }
+                text[length++] = *name;
+            }
+        }
+        if (capacity > 0) {
+            text[length] = '\0';
+        }
+        return capacity > 0 ? length : -1;
+    }
+
+    // ROTATED_POSITION[face][q - 1][position] is where the center at position goes when the whole
+    // cube turns like face by q quarter turns
+    struct RotationTables {
+        uint8_t position[FACE_ID_COUNT][3][FACE_ID_COUNT];
+    };
+
+    constexpr RotationTables buildRotationTables() {
+        RotationTables tables{};
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            for (int position = 0; position < FACE_ID_COUNT; position++) {
+                Ivec3 normal = FACE_NORMAL[position];
+                for (int q = 0; q < 3; q++) {
+                    normal = turnClockwise(normal, FACE_NORMAL[face]);
+                    for (int target = 0; target < FACE_ID_COUNT; target++) {
+                        if (FACE_NORMAL[target] == normal) {
+                            tables.position[face][q][position] = target;
+                        }
+                    }
+                }
+            }
+        }
+        return tables;
+    }
+
+    inline constexpr RotationTables ROTATED_POSITION = buildRotationTables();
+
+    // Face turns that, followed by the whole-cube rotations of the notation, have its effect, so
+    // the 3x3x3 engines can replay any notation up to how the cube is held. A rotation only
+    // relabels the faces of later turns, a wide turn is the opposite face turn plus a rotation
+    // (r = L x) and a slice the two face turns of its axis plus one (M = R L' x'). Returns the
+    // number of face turns, -1 if there are more than capacity; orientation (optional) receives
+    // the original face left at each position.
+    inline int toFaceTurns(const uint8_t *moves, int count, uint8_t *faceTurns, int capacity, uint8_t *orientation = nullptr) {
+        uint8_t faceAt[FACE_ID_COUNT] = {FACE_U, FACE_R, FACE_F, FACE_D, FACE_L, FACE_B};
+        int turns = 0;
+
+        for (int i = 0; i < count; i++) {
+            int kind = notationKind(moves[i]);
+            int face = notationFace(moves[i]);
+            int quarterTurns = moveQuarterTurns(moves[i]);
+
+            int needed = kind == MOVE_KIND_SLICE ? 2 : kind == MOVE_KIND_ROTATION ? 0 : 1;
+            if (turns + needed > capacity) {
+                return -1;
+            }
+            if (kind == MOVE_KIND_FACE) {
+                faceTurns[turns++] = faceAt[face] * 3 + quarterTurns - 1;
+                continue;
+            }
+            if (kind == MOVE_KIND_WIDE || kind == MOVE_KIND_SLICE) {
+                faceTurns[turns++] = faceAt[oppositeFace(face)] * 3 + quarterTurns - 1;
+            }
+            if (kind == MOVE_KIND_SLICE) {
+                faceTurns[turns++] = faceAt[face] * 3 + (4 - quarterTurns) - 1;
+            }
+
+            uint8_t rotated[FACE_ID_COUNT];
+            for (int position = 0; position < FACE_ID_COUNT; position++) {
+                rotated[ROTATED_POSITION.position[face][quarterTurns - 1][position]] = faceAt[position];
+            }
+            memcpy(faceAt, rotated, sizeof(faceAt));
+        }
+
+        if (orientation) {
+            memcpy(orientation, faceAt, sizeof(faceAt));
+        }
+        return turns;
+    }
+
+    // cube::nxnMove layer moves for an N x N x N cube: a wide turn is the two outer layers, a
+    // slice every layer but the outer two and a rotation all of them. Returns the number of
+    // layer moves, -1 if there are more than capacity.
+    inline int toLayerMoves(const uint8_t *moves, int count, int size, uint8_t *layerMoves, int capacity) {
+        int total = 0;
+        for (int i = 0; i < count; i++) {
+            int kind = notationKind(moves[i]);
+            int face = notationFace(moves[i]);
+            int quarterTurns = moveQuarterTurns(moves[i]);
+
+            int first = kind == MOVE_KIND_SLICE ? 1 : 0;
+            int last = kind == MOVE_KIND_FACE ? 0 : kind == MOVE_KIND_WIDE ? std::min(1, size - 1) :
+                       kind == MOVE_KIND_SLICE ? size - 2 : size - 1;
+            for (int layer = first; layer <= last; layer++) {
+                if (total == capacity) {
+                    return -1;
+                }
+                // The innermost layer of a face is the opposite face turning the other way
+                layerMoves[total++] = layer < size - 1 ? nxnMove(layer, face, quarterTurns) : nxnMove(0, oppositeFace(face), 4 - quarterTurns);
+            }
+        }
+        return total;
+    }
+
+    // Cancels and merges neighbouring moves in place and returns the new count: R R' goes, R R
+    // becomes R2, and the commuting face turns of an axis merge across each other (R L R' is L)
+    // and are kept in U, R, F before D, L, B order. Slices and rotations are stored in their
+    // parsed form so equal turns always merge.
+    constexpr int canonicalizeMoves(uint8_t *moves, int count) {
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            int move = canonicalMove(moves[i]);
+            int base = move - move % 3;
+            bool faceTurn = notationKind(move) == MOVE_KIND_FACE;
+
+            // The move merges into the last one, or into the one before it across a turn of the
+            // opposite face
+            int target = -1;
+            if (kept > 0 && moves[kept - 1] - moves[kept - 1] % 3 == base) {
+                target = kept - 1;
+            } else if (kept > 1 && faceTurn && notationKind(moves[kept - 1]) == MOVE_KIND_FACE &&
+                       notationFace(moves[kept - 1]) == oppositeFace(notationFace(move)) && moves[kept - 2] - moves[kept - 2] % 3 == base) {
+                target = kept - 2;
+            }
+
+            if (target >= 0) {
+                int quarterTurns = (moveQuarterTurns(moves[target]) + moveQuarterTurns(move)) % 4;
+                if (quarterTurns) {
+                    moves[target] = base + quarterTurns - 1;
+                } else {
+                    moves[target] = moves[kept - 1];
+                    kept--;
+                }
+                continue;
+            }
+
+            moves[kept++] = move;
+            if (kept > 1 && faceTurn && notationKind(moves[kept - 2]) == MOVE_KIND_FACE &&
+                notationFace(moves[kept - 2]) == oppositeFace(notationFace(move)) && notationFace(move) < FACE_D) {
+                moves[kept - 1] = moves[kept - 2];
+                moves[kept - 2] = move;
+            }
+        }
+        return kept;
+    }
+
+    constexpr bool canonicalizesTo(std::initializer_list<int> input, std::initializer_list<int> output) {
+        uint8_t moves[16] = {};
+        int count = 0;
+        for (int move : input) {
+            moves[count++] = move;
+        }
+        count = canonicalizeMoves(moves, count);
+
+        bool same = count == static_cast<int>(output.size());
+        for (int i = 0; same && i < count; i++) {
+            same = moves[i] == output.begin()[i];
+        }
+        return same;
+    }
+
+    // R = 3, R2 = 4, R' = 5, L = 12, U = 0, x = 57, x' written as a rotation about L = 66
+    static_assert(canonicalizesTo({3, 5}, {}) && canonicalizesTo({3, 3}, {4}) && canonicalizesTo({3, 4}, {5}), "same face turns merge");
+    static_assert(canonicalizesTo({12, 3}, {3, 12}) && canonicalizesTo({3, 12, 5}, {12}) && canonicalizesTo({0, 3, 5, 2}, {}), "axis turns commute");
+    static_assert(canonicalizesTo({57, 66}, {}) && canonicalizesTo({57, 3, 12}, {57, 3, 12}), "rotations only merge with rotations");
+    static_assert(canonicalMove(notationMove(MOVE_KIND_SLICE, FACE_R, 1)) == notationMove(MOVE_KIND_SLICE, FACE_L, 3), "M' is the slice about R");
+}
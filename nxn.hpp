@@ -0,0 +1,156 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// N x N x N cube state and layer moves.
+// Facelets follow CubeState's layout for any size: U, R, F, D, L, B, each face row-major as seen
+// from outside. Geometry uses doubled units so every cubie center is an integer (coordinates
+// -(N-1)..N-1 in steps of 2, faces at +-N), and the gather tables are derived from it once per
+// size. For N = 3 the facelets and the 18 outer layer moves are exactly cube.hpp's.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "cube.hpp"
+
+namespace cube {
+    constexpr int NXN_MIN_SIZE = 2;
+    constexpr int NXN_MAX_SIZE = 11; // the renderer's sticker index has 7 bits: 11 * 11 = 121
+
+    // Moves are ordered (layer * 6 + face) * 3 + quarter turns - 1, where layer counts inwards
+    // from the face (0 to N - 2), so the first 18 are the face turns in MOVE_NAMES order
+    constexpr int nxnMoveFace(int move) { return move / 3 % FACE_ID_COUNT; }
+    constexpr int nxnMoveLayer(int move) { return move / (3 * FACE_ID_COUNT); }
+    constexpr int nxnMove(int layer, int face, int quarterTurns) { return (layer * FACE_ID_COUNT + face) * 3 + quarterTurns - 1; }
+
+    struct NxnPuzzle {
+        int size = 0;
+        int faceletsPerFace = 0;
+        int faceletCount = 0;
+        int moveCount = 0;
+        std::vector<uint16_t> perm; // moveCount x faceletCount gather tables
+
+        const uint16_t *movePerm(int move) const { return perm.data() + static_cast<size_t>(move) * faceletCount; }
+    };
+
+    struct NxnState {
+        std::vector<uint8_t> facelets;
+        std::vector<uint8_t> scratch; // gather target, swapped in after every move
+    };
+
+    inline Ivec3 nxnFaceletPosition(int size, int facelet) {
+        int face = facelet / (size * size);
+        int row = 2 * (facelet % (size * size) / size) - (size - 1);
+        int col = 2 * (facelet % size) - (size - 1);
+        Ivec3 n = FACE_NORMAL[face], r = FACE_RIGHT[face], d = FACE_DOWN[face];
+        return {n.x*size + col*r.x + row*d.x, n.y*size + col*r.y + row*d.y, n.z*size + col*r.z + row*d.z};
+    }
+
+    // Facelet at a surface position facing normal, -1 if there is none
+    inline int nxnFaceletAt(int size, Ivec3 position, Ivec3 normal) {
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            if (FACE_NORMAL[face] == normal && dot(position, normal) == size) {
+                int row = (dot(position, FACE_DOWN[face]) + size - 1) / 2;
+                int col = (dot(position, FACE_RIGHT[face]) + size - 1) / 2;
+                return face * size * size + row * size + col;
+            }
+        }
+        return -1;
+    }
+
+    inline NxnPuzzle buildNxnPuzzle(int size) {
+        NxnPuzzle puzzle;
+        puzzle.size = size;
+        puzzle.faceletsPerFace = size * size;
+        puzzle.faceletCount = FACE_ID_COUNT * size * size;
+        puzzle.moveCount = (size - 1) * FACE_ID_COUNT * 3;
+        puzzle.perm.resize(static_cast<size_t>(puzzle.moveCount) * puzzle.faceletCount);
+
+        for (int layer = 0; layer < size - 1; layer++) {
+            for (int face = 0; face < FACE_ID_COUNT; face++) {
+                Ivec3 axis = FACE_NORMAL[face];
+                int move = (layer * FACE_ID_COUNT + face) * 3;
+                uint16_t *quarter = puzzle.perm.data() + static_cast<size_t>(move) * puzzle.faceletCount;
+
+                for (int i = 0; i < puzzle.faceletCount; i++) {
+                    quarter[i] = i;
+                }
+                for (int i = 0; i < puzzle.faceletCount; i++) {
+                    Ivec3 position = nxnFaceletPosition(size, i);
+                    Ivec3 normal = FACE_NORMAL[i / puzzle.faceletsPerFace];
+                    Ivec3 cubie = {position.x - normal.x, position.y - normal.y, position.z - normal.z};
+                    if (dot(cubie, axis) == size - 1 - 2 * layer) {
+                        quarter[nxnFaceletAt(size, turnClockwise(position, axis), turnClockwise(normal, axis))] = i;
+                    }
+                }
+
+                // Half and counter-clockwise turns are the quarter turn composed with itself
+                for (int power = 1; power < 3; power++) {
+                    uint16_t *previous = quarter + static_cast<size_t>(power - 1) * puzzle.faceletCount;
+                    uint16_t *table = quarter + static_cast<size_t>(power) * puzzle.faceletCount;
+                    for (int i = 0; i < puzzle.faceletCount; i++) {
+                        table[i] = previous[quarter[i]];
+                    }
+                }
+            }
+        }
+        return puzzle;
+    }
+
+    inline NxnState nxnSolvedState(const NxnPuzzle &puzzle) {
+        NxnState state;
+        state.facelets.resize(puzzle.faceletCount);
+        state.scratch.resize(puzzle.faceletCount);
+        for (int i = 0; i < puzzle.faceletCount; i++) {
+            state.facelets[i] = static_cast<uint8_t>(i / puzzle.faceletsPerFace);
+        }
+        return state;
+    }
+
+    inline void applyMove(const NxnPuzzle &puzzle, NxnState &state, int move) {
+        const uint16_t *perm = puzzle.movePerm(move);
+        for (int i = 0; i < puzzle.faceletCount; i++) {
+            state.scratch[i] = state.facelets[perm[i]];
+        }
+        state.facelets.swap(state.scratch);
+    }
+
+    // Only meaningful for size 3, where the layouts are the same
+    inline CubeState toCubeState(const NxnState &state) {
+        CubeState cube;
+        memcpy(cube.facelets, state.facelets.data(), FACELET_COUNT);
+        return cube;
+    }
+
+    // toCubeState recolored so every center is home. Slices and rotations move the centers of a
+    // size 3 cube, which the solvers assume never happens (after M the corners and edges decode
+    // with mismatched parities). Recoloring only renames the colors, so face turns that solve the
+    // result solve the displayed cube, held as it is.
+    inline CubeState toCenteredCubeState(const NxnState &state) {
+        uint8_t recolor[FACE_ID_COUNT] = {};
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            recolor[state.facelets[face * FACELETS_PER_FACE + 4]] = static_cast<uint8_t>(face);
+        }
+
+        CubeState cube;
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            cube.facelets[i] = recolor[state.facelets[i]];
+        }
+        return cube;
+    }
+}
@@ -0,0 +1,465 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Optimal solver: IDA* bounded by pattern databases (Korf's method), the exact distance of the 8
+// corners and of two sets of 6 edges, 4 bits per entry. The corner table indexes the corner
+// permutation by its class under the 16 U/D symmetries, and the two edge sets are images of each
+// other under the F2 symmetry, so one edge table serves both. Each iteration expands the top of
+// the tree into subtrees that a work-stealing pool searches, and a lock-free transposition filter
+// drops subtrees another thread already started from the same state.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "twophase.hpp"
+
+namespace cube {
+    /* Pattern databases */
+
+    enum PatternDatabaseId {
+        PDB_CORNERS, // corner permutation class x twist
+        PDB_EDGES,   // UR UF UL UB FR BL, and through F2 the other six: DL DF DR DB FL BR
+        PDB_COUNT
+    };
+
+    constexpr int PATTERN_EDGES = 6;
+    constexpr uint32_t EDGE_PATTERN_PERMS = 665280; // 12! / 6! placements of 6 edges
+    constexpr uint32_t PATTERN_DATABASES_VERSION = 2;
+
+    constexpr uint8_t PATTERN_EDGE_IDS[PATTERN_EDGES] = {EDGE_UR, EDGE_UF, EDGE_UL, EDGE_UB, EDGE_FR, EDGE_BL};
+    constexpr int8_t PATTERN_EDGE_SLOT[EDGE_COUNT] = {0, 1, 2, 3, -1, -1, -1, -1, 4, -1, 5, -1};
+
+    constexpr uint32_t PDB_ENTRIES[PDB_COUNT] = {
+        CORNER_PERM_CLASS_COUNT * TWIST_COUNT,
+        EDGE_PATTERN_PERMS << PATTERN_EDGES,
+    };
+
+    constexpr uint32_t pdbWords(int table) { return (PDB_ENTRIES[table] + 15) / 16; }
+    constexpr uint32_t pdbWordOffset(int table) { return table == 0 ? 0 : pdbWordOffset(table - 1) + pdbWords(table - 1); }
+    constexpr uint64_t PATTERN_DATABASES_BYTES = static_cast<uint64_t>(pdbWordOffset(PDB_COUNT)) * sizeof(uint64_t);
+
+    // An edge slot is position * 2 + flip; the tables give the slot an edge moves to
+    struct EdgeSlotMoves {
+        uint8_t next[EDGE_COUNT * 2][MOVE_COUNT];
+    };
+
+    constexpr EdgeSlotMoves buildEdgeSlotMoves() {
+        EdgeSlotMoves table = {};
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            const CubieCube &m = MOVE_CUBIES.move[move];
+            for (int i = 0; i < EDGE_COUNT; i++) {
+                for (int flip = 0; flip < 2; flip++) {
+                    table.next[m.ep[i] * 2 + flip][move] = static_cast<uint8_t>(i * 2 + (flip ^ m.eo[i]));
+                }
+            }
+        }
+        return table;
+    }
+
+    inline constexpr EdgeSlotMoves EDGE_SLOT_MOVES = buildEdgeSlotMoves();
+
+    // The positions of the 6 edges in order, as digits among the positions still free, then
+    // their flips in the low 6 bits
+    inline uint32_t edgePatternIndex(const uint8_t slots[PATTERN_EDGES]) {
+        uint32_t used = 0;
+        uint32_t rank = 0;
+        uint32_t flips = 0;
+        for (int k = 0; k < PATTERN_EDGES; k++) {
+            uint32_t position = slots[k] >> 1;
+            rank = rank * (EDGE_COUNT - k) + position - __builtin_popcount(used & ((1u << position) - 1));
+            used |= 1u << position;
+            flips |= (slots[k] & 1u) << k;
+        }
+        return rank << PATTERN_EDGES | flips;
+    }
+
+    inline void setEdgePattern(uint8_t slots[PATTERN_EDGES], uint32_t index) {
+        uint32_t rank = index >> PATTERN_EDGES;
+        int digits[PATTERN_EDGES];
+        for (int k = PATTERN_EDGES - 1; k >= 0; k--) {
+            digits[k] = rank % (EDGE_COUNT - k);
+            rank /= EDGE_COUNT - k;
+        }
+
+        uint32_t used = 0;
+        for (int k = 0; k < PATTERN_EDGES; k++) {
+            int position = 0;
+            for (int free = digits[k]; free || (used >> position & 1); position++) {
+                if (!(used >> position & 1)) {
+                    free--;
+                }
+            }
+            used |= 1u << position;
+            slots[k] = static_cast<uint8_t>(position * 2 + (index >> k & 1));
+        }
+    }
+
+    inline void edgePatternSlots(const CubieCube &c, uint8_t slots[PATTERN_EDGES]) {
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            if (PATTERN_EDGE_SLOT[c.ep[i]] >= 0) {
+                slots[PATTERN_EDGE_SLOT[c.ep[i]]] = static_cast<uint8_t>(i * 2 + c.eo[i]);
+            }
+        }
+    }
+
+    inline uint32_t cornerPatternIndex(const SymmetryTables &sym, int cornerPerm, int twist) {
+        uint16_t reduced = sym.cornerPermSym[cornerPerm];
+        return symClass(reduced) * TWIST_COUNT + sym.twistConj[twist][symIndex(reduced)];
+    }
+
+    // A neighbor whose corner permutation class representative is fixed by some symmetries
+    // stands for one entry per such symmetry
+    inline void generateCornerDatabase(uint64_t *words, const CoordMoveTables &moves, const SymmetryTables &sym, int threads, DepthTableStats *stats = nullptr) {
+        generateDepthTable(words, PDB_ENTRIES[PDB_CORNERS], 0, [&](uint32_t index, auto &&visit) {
+            uint32_t cornerPerm = sym.cornerPermRep[index / TWIST_COUNT];
+            uint32_t twist = index % TWIST_COUNT;
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                uint32_t neighbor = cornerPatternIndex(sym, moves.cornerPerm[cornerPerm][move], moves.twist[twist][move]);
+                uint32_t neighborClass = neighbor / TWIST_COUNT;
+                uint32_t neighborTwist = neighbor % TWIST_COUNT;
+                if (visit(neighbor)) {
+                    return;
+                }
+                for (int s = 1; s < SYMMETRY_COUNT; s++) {
+                    if ((sym.cornerPermStabilizer[neighborClass] >> s & 1) && visit(neighborClass * TWIST_COUNT + sym.twistConj[neighborTwist][s])) {
+                        return;
+                    }
+                }
+            }
+        }, threads, stats);
+    }
+
+    // The database of any six edges; the solver only needs PATTERN_EDGE_IDS, the other set is
+    // generated by --bench-symmetry to check the F2 lookup against
+    inline void generateEdgeDatabase(uint64_t *words, int threads, DepthTableStats *stats = nullptr, const uint8_t *edgeIds = PATTERN_EDGE_IDS) {
+        uint8_t solvedSlots[PATTERN_EDGES];
+        for (int k = 0; k < PATTERN_EDGES; k++) {
+            solvedSlots[k] = static_cast<uint8_t>(edgeIds[k] * 2);
+        }
+        generateDepthTable(words, PDB_ENTRIES[PDB_EDGES], edgePatternIndex(solvedSlots), [&](uint32_t index, auto &&visit) {
+            uint8_t slots[PATTERN_EDGES];
+            uint8_t next[PATTERN_EDGES];
+            setEdgePattern(slots, index);
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                for (int k = 0; k < PATTERN_EDGES; k++) {
+                    next[k] = EDGE_SLOT_MOVES.next[slots[k]][move];
+                }
+                if (visit(edgePatternIndex(next))) {
+                    return;
+                }
+            }
+        }, threads, stats);
+    }
+
+    inline void generatePatternDatabases(uint64_t *words, const CoordMoveTables &moves, const SymmetryTables &sym, int threads = parallel::threadCount()) {
+        generateCornerDatabase(words + pdbWordOffset(PDB_CORNERS), moves, sym, threads);
+        generateEdgeDatabase(words + pdbWordOffset(PDB_EDGES), threads);
+    }
+
+    struct PatternDatabases {
+        const uint8_t *table[PDB_COUNT];
+    };
+
+    // Mapped from the cache, or generated (and cached) on first use
+    inline const PatternDatabases &patternDatabases(TableLoadStats *stats = nullptr) {
+        static TableLoadStats loadStats;
+        static std::vector<uint64_t> generated;
+        static PatternDatabases tables = [] {
+            std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+            const uint8_t *data = tablecache::mapTable("optimal-pattern-databases.bin", PATTERN_DATABASES_VERSION, PATTERN_DATABASES_BYTES);
+            loadStats.fromCache = data != nullptr;
+            if (!data) {
+                const CoordMoveTables &moves = coordMoveTables();
+                loadStats.threads = parallel::threadCount();
+                generated.resize(PATTERN_DATABASES_BYTES / sizeof(uint64_t));
+                generatePatternDatabases(generated.data(), moves, symmetryTables(), loadStats.threads);
+                tablecache::writeTable("optimal-pattern-databases.bin", PATTERN_DATABASES_VERSION, generated.data(), PATTERN_DATABASES_BYTES);
+                data = reinterpret_cast<const uint8_t *>(generated.data());
+            }
+
+            PatternDatabases mapped;
+            for (int table = 0; table < PDB_COUNT; table++) {
+                mapped.table[table] = data + pdbWordOffset(table) * sizeof(uint64_t);
+            }
+            loadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return mapped;
+        }();
+
+        if (stats) {
+            *stats = loadStats;
+        }
+        return tables;
+    }
+
+    /* Search */
+
+    // The second edge set is followed as the first set of the cube conjugated by F2, which turns
+    // with the conjugated moves
+    struct OptimalNode {
+        uint16_t cornerPerm;
+        uint16_t twist;
+        uint8_t edges[2][PATTERN_EDGES];
+        uint32_t edgeIndex[2];
+    };
+
+    constexpr int edgeSetMove(int set, int move) { return set ? SYMMETRIES.sym[SYM_F2].move[move] : move; }
+
+    inline OptimalNode optimalNode(const CubieCube &c) {
+        OptimalNode node;
+        node.cornerPerm = static_cast<uint16_t>(getCornerPerm(c));
+        node.twist = static_cast<uint16_t>(getTwist(c));
+        edgePatternSlots(c, node.edges[0]);
+        edgePatternSlots(conjugate(c, SYMMETRIES.sym[SYM_F2]), node.edges[1]);
+        for (int set = 0; set < 2; set++) {
+            node.edgeIndex[set] = edgePatternIndex(node.edges[set]);
+        }
+        return node;
+    }
+
+    inline OptimalNode applyMove(const OptimalNode &node, int move, const CoordMoveTables &moves) {
+        OptimalNode next;
+        next.cornerPerm = moves.cornerPerm[node.cornerPerm][move];
+        next.twist = moves.twist[node.twist][move];
+        for (int set = 0; set < 2; set++) {
+            for (int k = 0; k < PATTERN_EDGES; k++) {
+                next.edges[set][k] = EDGE_SLOT_MOVES.next[node.edges[set][k]][edgeSetMove(set, move)];
+            }
+            next.edgeIndex[set] = edgePatternIndex(next.edges[set]);
+        }
+        return next;
+    }
+
+    // Zero only for the solved cube, since the corner and both edge patterns cover every cubie
+    inline int optimalBound(const PatternDatabases &pdb, const SymmetryTables &sym, const OptimalNode &node) {
+        return std::max({pruneDepth(pdb.table[PDB_CORNERS], cornerPatternIndex(sym, node.cornerPerm, node.twist)),
+                         pruneDepth(pdb.table[PDB_EDGES], node.edgeIndex[0]),
+                         pruneDepth(pdb.table[PDB_EDGES], node.edgeIndex[1])});
+    }
+
+    // applyMove and optimalBound in one, stopping at the first database that puts the child at
+    // togo or more moves from solved, so most rejected children cost a single lookup
+    inline bool applyMoveWithin(const OptimalNode &node, int move, int togo, const CoordMoveTables &moves, const SymmetryTables &sym, const PatternDatabases &pdb, OptimalNode &next) {
+        next.cornerPerm = moves.cornerPerm[node.cornerPerm][move];
+        next.twist = moves.twist[node.twist][move];
+        if (pruneDepth(pdb.table[PDB_CORNERS], cornerPatternIndex(sym, next.cornerPerm, next.twist)) >= togo) {
+            return false;
+        }
+
+        for (int set = 0; set < 2; set++) {
+            for (int k = 0; k < PATTERN_EDGES; k++) {
+                next.edges[set][k] = EDGE_SLOT_MOVES.next[node.edges[set][k]][edgeSetMove(set, move)];
+            }
+            next.edgeIndex[set] = edgePatternIndex(next.edges[set]);
+            if (pruneDepth(pdb.table[PDB_EDGES], next.edgeIndex[set]) >= togo) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // One 64 bit entry per slot: the high 48 bits of the state hash, the iteration bound and the
+    // depth the state was entered at. A state entered again in the same iteration at the same or
+    // a greater depth (after the same face, so the same moves follow) cannot find anything new.
+    // Entries are overwritten freely and two states sharing 48 hash bits and a slot would be
+    // confused, which makes the filter approximate.
+    struct TranspositionFilter {
+        static const int BITS = 20;
+        std::unique_ptr<std::atomic<uint64_t>[]> entries;
+
+        TranspositionFilter() : entries(new std::atomic<uint64_t>[1u << BITS]) {
+            for (uint32_t i = 0; i < (1u << BITS); i++) {
+                entries[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // False if the subtree should be skipped, otherwise records it
+        bool enter(uint64_t hash, int bound, int depth) {
+            std::atomic<uint64_t> &entry = entries[hash & ((1u << BITS) - 1)];
+            uint64_t current = entry.load(std::memory_order_relaxed);
+            if ((current >> 16) == (hash >> 16) && static_cast<int>(current >> 8 & 0xFF) == bound && static_cast<int>(current & 0xFF) <= depth) {
+                return false;
+            }
+            entry.store((hash & ~0xFFFFull) | static_cast<uint64_t>(bound) << 8 | static_cast<uint64_t>(depth), std::memory_order_relaxed);
+            return true;
+        }
+    };
+
+    inline uint64_t mixHash(uint64_t x) {
+        x ^= x >> 31;
+        x *= 0x7FB5D329728EA185ull;
+        x ^= x >> 27;
+        x *= 0x81DADEF4BC2DD44Dull;
+        return x ^ (x >> 33);
+    }
+
+    inline uint64_t nodeHash(const OptimalNode &node, int lastFace) {
+        uint64_t corners = static_cast<uint64_t>(node.cornerPerm) * TWIST_COUNT + node.twist;
+        return mixHash(corners | static_cast<uint64_t>(node.edgeIndex[0]) << 27 | static_cast<uint64_t>(lastFace + 1) << 53) ^
+               mixHash(node.edgeIndex[1] + 0x9E3779B97F4A7C15ull);
+    }
+
+    constexpr int OPTIMAL_MAX_DEPTH = 20;     // God's number in the half-turn metric
+    constexpr int OPTIMAL_SPLIT_DEPTH = 3;    // subtrees handed to the pool start this deep
+    constexpr int TRANSPOSITION_MIN_TOGO = 4; // smaller subtrees are cheaper to search than to filter
+
+    struct OptimalStats {
+        uint64_t nodes = 0;
+        double seconds = 0.0;
+        int threads = 0;
+    };
+
+    struct OptimalSearch {
+        const CoordMoveTables &moves;
+        const SymmetryTables &sym;
+        const PatternDatabases &pdb;
+        TranspositionFilter &filter;
+        int bound;
+        std::atomic<bool> found;
+        Solution solution;
+    };
+
+    inline bool optimalSearch(OptimalSearch &s, const OptimalNode &node, uint8_t *path, int depth, int togo, uint64_t &nodes) {
+        nodes++;
+        if (togo == 0) {
+            return true; // the parent only descends into children with a bound of 0
+        }
+        if (s.found.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        int previous = depth ? path[depth - 1] : -1;
+        if (togo >= TRANSPOSITION_MIN_TOGO && depth && !s.filter.enter(nodeHash(node, moveFace(previous)), s.bound, depth)) {
+            return false;
+        }
+
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            if (redundantMove(previous, move)) {
+                continue;
+            }
+
+            OptimalNode next;
+            if (!applyMoveWithin(node, move, togo, s.moves, s.sym, s.pdb, next)) {
+                continue;
+            }
+
+            path[depth] = static_cast<uint8_t>(move);
+            if (optimalSearch(s, next, path, depth + 1, togo - 1, nodes)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct OptimalTask {
+        OptimalNode node;
+        uint8_t path[OPTIMAL_SPLIT_DEPTH];
+    };
+
+    // The nodes splitDepth moves deep that can still reach the solved cube within the bound
+    inline void collectOptimalTasks(const OptimalSearch &s, const OptimalNode &node, uint8_t *path, int depth, int splitDepth, std::vector<OptimalTask> &tasks) {
+        if (depth == splitDepth) {
+            OptimalTask task;
+            task.node = node;
+            memcpy(task.path, path, depth);
+            tasks.push_back(task);
+            return;
+        }
+
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            if (redundantMove(depth ? path[depth - 1] : -1, move)) {
+                continue;
+            }
+            OptimalNode next = applyMove(node, move, s.moves);
+            if (depth + 1 + optimalBound(s.pdb, s.sym, next) <= s.bound) {
+                path[depth] = static_cast<uint8_t>(move);
+                collectOptimalTasks(s, next, path, depth + 1, splitDepth, tasks);
+            }
+        }
+    }
+
+    // Shortest solution in the half-turn metric; length -1 if the cube is not solvable
+    inline Solution solveOptimal(const CubieCube &c, int threads = parallel::threadCount(), OptimalStats *stats = nullptr) {
+        std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+        const CoordMoveTables &moves = coordMoveTables();
+        const SymmetryTables &sym = symmetryTables();
+        const PatternDatabases &pdb = patternDatabases();
+        // Fresh per solve: entries of subtrees cut short once a solution was found prove nothing
+        TranspositionFilter filter;
+
+        OptimalNode root = optimalNode(c);
+        OptimalSearch s = {moves, sym, pdb, filter, 0, {false}, Solution()};
+        std::atomic<uint64_t> totalNodes(0);
+
+        for (int bound = optimalBound(pdb, sym, root); bound <= OPTIMAL_MAX_DEPTH && !s.found.load(); bound++) {
+            s.bound = bound;
+            int splitDepth = std::min(bound, OPTIMAL_SPLIT_DEPTH);
+
+            uint8_t prefix[OPTIMAL_SPLIT_DEPTH];
+            std::vector<OptimalTask> tasks;
+            collectOptimalTasks(s, root, prefix, 0, splitDepth, tasks);
+
+            parallel::parallelForStealing(tasks.size(), [&](size_t t) {
+                uint8_t path[MAX_SOLUTION_LENGTH];
+                memcpy(path, tasks[t].path, splitDepth);
+                uint64_t nodes = 0;
+                if (optimalSearch(s, tasks[t].node, path, splitDepth, bound - splitDepth, nodes)) {
+                    bool expected = false;
+                    if (s.found.compare_exchange_strong(expected, true)) {
+                        s.solution.length = bound;
+                        memcpy(s.solution.moves, path, bound);
+                    }
+                }
+                totalNodes.fetch_add(nodes, std::memory_order_relaxed);
+            }, threads);
+        }
+
+        if (stats) {
+            stats->nodes = totalNodes.load();
+            stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats->threads = threads;
+        }
+        return s.solution;
+    }
+
+    // Unsolvable states are rejected up front, the search would only stop at OPTIMAL_MAX_DEPTH
+    inline Solution solveOptimal(const CubeState &state, int threads = parallel::threadCount(), OptimalStats *stats = nullptr) {
+        CubieCube c;
+        if (!faceletToCubie(state, c) || !isSolvable(c)) {
+            return Solution();
+        }
+        return solveOptimal(c, threads, stats);
+    }
+
+    constexpr bool edgeSetsSwapUnderF2() {
+        for (int k = 0; k < PATTERN_EDGES; k++) {
+            if (PATTERN_EDGE_SLOT[SYMMETRIES.sym[SYM_F2].edge[PATTERN_EDGE_IDS[k]]] >= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(edgeSetsSwapUnderF2(), "F2 takes the pattern edges onto the other six");
+    static_assert(EDGE_SLOT_MOVES.next[EDGE_UR * 2][0] == EDGE_UF * 2 || EDGE_SLOT_MOVES.next[EDGE_UR * 2][0] == EDGE_UB * 2, "U moves UR along the U layer");
+}
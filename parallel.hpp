@@ -0,0 +1,132 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Minimal fork-join helpers for the table generators and solvers.
+
+#pragma once
+
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+    inline int threadCount() {
+        unsigned hardware = std::thread::hardware_concurrency();
+        return hardware ? static_cast<int>(hardware) : 1;
+    }
+
+    // Calls fn(i) for every i in [begin, end), handing out chunks of the range to the threads
+    // as they finish so uneven rows still balance
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, Fn &&fn, int threads = threadCount()) {
+        if (end <= begin) {
+            return;
+        }
+
+        size_t chunk = std::max<size_t>(1, (end - begin) / (static_cast<size_t>(threads) * 16));
+        std::atomic<size_t> next(begin);
+
+        auto worker = [&]() {
+            for (;;) {
+                size_t first = next.fetch_add(chunk, std::memory_order_relaxed);
+                if (first >= end) {
+                    return;
+                }
+                size_t last = std::min(end, first + chunk);
+                for (size_t i = first; i < last; i++) {
+                    fn(i);
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; t++) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+    }
+
+    // Calls fn(i) for every task i in [0, count) when tasks vary wildly in cost. Every thread
+    // owns a contiguous share and takes tasks from its front; a thread that runs dry steals the
+    // back half of the largest remaining share, so one huge subtree never leaves the rest idle.
+    template <typename Fn>
+    void parallelForStealing(size_t count, Fn &&fn, int threads = threadCount()) {
+        struct alignas(64) Share {
+            std::mutex lock;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        threads = std::max(1, std::min<int>(threads, static_cast<int>(std::max<size_t>(count, 1))));
+        std::vector<Share> shares(threads);
+        for (int t = 0; t < threads; t++) {
+            shares[t].begin = count * t / threads;
+            shares[t].end = count * (t + 1) / threads;
+        }
+
+        auto worker = [&](int self) {
+            Share &own = shares[self];
+            for (;;) {
+                size_t task;
+                {
+                    std::lock_guard<std::mutex> guard(own.lock);
+                    task = own.begin < own.end ? own.begin++ : count;
+                }
+                if (task < count) {
+                    fn(task);
+                    continue;
+                }
+
+                int victim = -1;
+                size_t most = 0;
+                for (int t = 0; t < threads; t++) {
+                    std::lock_guard<std::mutex> guard(shares[t].lock);
+                    if (shares[t].end - shares[t].begin > most) {
+                        most = shares[t].end - shares[t].begin;
+                        victim = t;
+                    }
+                }
+                if (victim < 0) {
+                    return;
+                }
+
+                std::scoped_lock guard(own.lock, shares[victim].lock);
+                Share &from = shares[victim];
+                if (from.begin < from.end) {
+                    size_t middle = from.end - (from.end - from.begin + 1) / 2;
+                    own.begin = middle;
+                    own.end = from.end;
+                    from.end = middle;
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; t++) {
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+    }
+}
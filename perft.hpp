@@ -0,0 +1,132 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Move tree enumeration ("perft"): every canonical face turn sequence up to a depth, applied
+// to packed states, with the distinct positions counted in an open addressing set of 64 bit
+// state hashes. The counts per depth are known exactly, so a wrong move table, a broken packed
+// move or a weak hash shows up as a mismatch, and the run times the engine end to end.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "cube.hpp"
+
+namespace cube {
+    constexpr int PERFT_MAX_DEPTH = 7;
+
+    // Positions at exactly each distance from solved in the half-turn metric
+    constexpr uint64_t PERFT_POSITIONS[PERFT_MAX_DEPTH + 1] = {1, 18, 243, 3240, 43239, 574908, 7618438, 100803036};
+
+    // The 54 facelets and two padding bytes as seven words, multiplied and folded in turn
+    inline uint64_t stateHash(const PackedState &state) {
+        uint64_t hash = 0;
+        for (int w = 0; w < 7; w++) {
+            uint64_t word;
+            memcpy(&word, state.bytes + w * 8, sizeof(word));
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+            hash ^= hash >> 29;
+        }
+        hash *= 0xBF58476D1CE4E5B9ull;
+        return hash ^ (hash >> 32);
+    }
+
+    // Linear probing over a power of two array of hashes, 0 marking an empty slot (a hash of 0 is
+    // stored as 1). Grows to keep the load at most one half, so probes stay within a cache line
+    // or two.
+    struct PositionSet {
+        std::vector<uint64_t> slots;
+        uint64_t size = 0;
+        uint64_t probes = 0; // slots looked at by inserts, for the average probe length
+
+        explicit PositionSet(uint64_t capacity = 1 << 16) : slots(capacity) {}
+
+        bool insert(uint64_t hash) {
+            hash = hash ? hash : 1;
+            if ((size + 1) * 2 > slots.size()) {
+                grow();
+            }
+
+            uint64_t mask = slots.size() - 1;
+            for (uint64_t slot = hash & mask;; slot = (slot + 1) & mask) {
+                probes++;
+                if (slots[slot] == hash) {
+                    return false;
+                }
+                if (slots[slot] == 0) {
+                    slots[slot] = hash;
+                    size++;
+                    return true;
+                }
+            }
+        }
+
+        void grow() {
+            std::vector<uint64_t> old(slots.size() * 2);
+            old.swap(slots);
+            uint64_t mask = slots.size() - 1;
+            for (uint64_t hash : old) {
+                if (hash) {
+                    uint64_t slot = hash & mask;
+                    while (slots[slot]) {
+                        slot = (slot + 1) & mask;
+                    }
+                    slots[slot] = hash;
+                }
+            }
+        }
+    };
+
+    struct PerftLayer {
+        uint64_t sequences = 0; // canonical sequences of exactly this length
+        uint64_t positions = 0; // positions first reached at this length, so at this distance
+        double seconds = 0.0;
+    };
+
+    // Canonical sequences never turn a face twice in a row or an opposite face in the
+    // non-canonical order (see redundantMove), which leaves 18, 243, 3240, ... of them
+    inline void perftVisit(const PackedState &state, int previous, int togo, PositionSet &set, PerftLayer &layer) {
+        if (togo == 0) {
+            layer.sequences++;
+            layer.positions += set.insert(stateHash(state));
+            return;
+        }
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            if (redundantMove(previous, move)) {
+                continue;
+            }
+            PackedState next = state;
+            applyMove(next, move);
+            perftVisit(next, move, togo - 1, set, layer);
+        }
+    }
+
+    // One enumeration per depth, all into the same set: a position inserted at length d and not
+    // at any shorter length is exactly d moves from solved
+    inline std::vector<PerftLayer> perft(int maxDepth, PositionSet &set) {
+        std::vector<PerftLayer> layers(maxDepth + 1);
+        PackedState solved = pack(solvedState());
+        for (int depth = 0; depth <= maxDepth; depth++) {
+            std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+            perftVisit(solved, -1, depth, set, layers[depth]);
+            layers[depth].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return layers;
+    }
+}
@@ -0,0 +1,233 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// 2x2x2 (pocket cube) solver: the exact distance of every state, 4 bits each.
+// A 2x2x2 has no centers, so the whole cube is held by its DBL corner and turned with U, R and F
+// only, which never move that corner. The other 7 corners give 7! * 3^6 = 3674160 states, a
+// 1.8MB depth table generated once on every core, cached and mapped read-only afterwards. A
+// solve just follows the table downhill from the state, one lookup per candidate move.
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "coord.hpp"
+#include "depthtable.hpp"
+#include "nxn.hpp"
+#include "twophase.hpp"
+
+namespace cube {
+    constexpr int POCKET_CORNERS = 7;             // every corner but DBL
+    constexpr int POCKET_PERM_COUNT = 5040;       // 7!
+    constexpr int POCKET_TWIST_COUNT = 729;       // 3^6, the last twist follows from the others
+    constexpr uint32_t POCKET_STATE_COUNT = POCKET_PERM_COUNT * POCKET_TWIST_COUNT;
+    constexpr int POCKET_MOVE_COUNT = 9;          // U, R and F turns, the first 9 moves
+    constexpr int POCKET_MAX_DEPTH = 11;          // God's number of the 2x2x2 in the half-turn metric
+    constexpr uint32_t POCKET_TABLE_VERSION = 1;
+    constexpr uint64_t POCKET_TABLE_BYTES = (POCKET_STATE_COUNT + 15) / 16 * sizeof(uint64_t);
+
+    constexpr uint8_t POCKET_POSITIONS[POCKET_CORNERS] = {CORNER_URF, CORNER_UFL, CORNER_ULB, CORNER_UBR, CORNER_DFR, CORNER_DLF, CORNER_DRB};
+
+    // Only meaningful for cubes with DBL solved
+    constexpr uint32_t pocketIndex(const CubieCube &c) {
+        uint8_t values[POCKET_CORNERS] = {};
+        uint32_t twist = 0;
+        for (int k = 0; k < POCKET_CORNERS; k++) {
+            values[k] = c.cp[POCKET_POSITIONS[k]];
+            twist = k < POCKET_CORNERS - 1 ? twist * 3 + c.co[POCKET_POSITIONS[k]] : twist;
+        }
+        return permutationIndex(values, POCKET_CORNERS) * POCKET_TWIST_COUNT + twist;
+    }
+
+    constexpr CubieCube pocketCubie(uint32_t index) {
+        CubieCube c = solvedCubie();
+        uint8_t values[POCKET_CORNERS] = {};
+        setPermutation(values, POCKET_CORNERS, index / POCKET_TWIST_COUNT, 0);
+
+        uint32_t twist = index % POCKET_TWIST_COUNT;
+        int twistSum = 0;
+        for (int k = POCKET_CORNERS - 1; k >= 0; k--) {
+            c.cp[POCKET_POSITIONS[k]] = POCKET_POSITIONS[values[k]];
+            if (k < POCKET_CORNERS - 1) {
+                c.co[POCKET_POSITIONS[k]] = twist % 3;
+                twistSum += twist % 3;
+                twist /= 3;
+            }
+        }
+        c.co[POCKET_POSITIONS[POCKET_CORNERS - 1]] = (3 - twistSum % 3) % 3;
+        return c;
+    }
+
+    // Uniform over the states: every index is a distinct reachable state
+    template <typename Rng>
+    CubieCube randomPocketCubie(Rng &rng) {
+        return pocketCubie(std::uniform_int_distribution<uint32_t>(0, POCKET_STATE_COUNT - 1)(rng));
+    }
+
+    struct PocketMoveTables {
+        uint32_t next[POCKET_STATE_COUNT / POCKET_TWIST_COUNT][POCKET_MOVE_COUNT]; // permutation part, times POCKET_TWIST_COUNT
+        uint16_t twist[POCKET_TWIST_COUNT][POCKET_MOVE_COUNT];
+
+        uint32_t apply(uint32_t index, int move) const {
+            return next[index / POCKET_TWIST_COUNT][move] + twist[index % POCKET_TWIST_COUNT][move];
+        }
+    };
+
+    // Built on first use in about a millisecond: a permutation and a twist are moved separately,
+    // each from a cube holding only that part
+    inline const PocketMoveTables &pocketMoveTables() {
+        static std::unique_ptr<PocketMoveTables> tables = [] {
+            std::unique_ptr<PocketMoveTables> built(new PocketMoveTables);
+            for (int perm = 0; perm < POCKET_PERM_COUNT; perm++) {
+                CubieCube c = pocketCubie(perm * POCKET_TWIST_COUNT);
+                for (int move = 0; move < POCKET_MOVE_COUNT; move++) {
+                    built->next[perm][move] = pocketIndex(multiply(c, MOVE_CUBIES.move[move])) / POCKET_TWIST_COUNT * POCKET_TWIST_COUNT;
+                }
+            }
+            for (int twist = 0; twist < POCKET_TWIST_COUNT; twist++) {
+                CubieCube c = pocketCubie(twist);
+                for (int move = 0; move < POCKET_MOVE_COUNT; move++) {
+                    built->twist[twist][move] = static_cast<uint16_t>(pocketIndex(multiply(c, MOVE_CUBIES.move[move])) % POCKET_TWIST_COUNT);
+                }
+            }
+            return built;
+        }();
+        return *tables;
+    }
+
+    inline void generatePocketTable(uint64_t *words, int threads = parallel::threadCount(), DepthTableStats *stats = nullptr) {
+        const PocketMoveTables &moves = pocketMoveTables();
+        generateDepthTable(words, POCKET_STATE_COUNT, 0, [&](uint32_t index, auto &&visit) {
+            for (int move = 0; move < POCKET_MOVE_COUNT; move++) {
+                if (visit(moves.apply(index, move))) {
+                    return;
+                }
+            }
+        }, threads, stats);
+    }
+
+    // Mapped from the cache, or generated (and cached) on first use
+    inline const uint8_t *pocketTable(TableLoadStats *stats = nullptr) {
+        static TableLoadStats loadStats;
+        static std::vector<uint64_t> generated;
+        static const uint8_t *table = [] {
+            std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+            const uint8_t *data = tablecache::mapTable("pocket-distance-table.bin", POCKET_TABLE_VERSION, POCKET_TABLE_BYTES);
+            loadStats.fromCache = data != nullptr;
+            if (!data) {
+                loadStats.threads = parallel::threadCount();
+                generated.resize(POCKET_TABLE_BYTES / sizeof(uint64_t));
+                generatePocketTable(generated.data(), loadStats.threads);
+                tablecache::writeTable("pocket-distance-table.bin", POCKET_TABLE_VERSION, generated.data(), POCKET_TABLE_BYTES);
+                data = reinterpret_cast<const uint8_t *>(generated.data());
+            }
+
+            loadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return data;
+        }();
+
+        if (stats) {
+            *stats = loadStats;
+        }
+        return table;
+    }
+
+    // The corners of a 2x2x2 read as those of a 3x3x3, recolored so the cubie in the DBL position
+    // is solved: its D, B and L facelets name those faces and every other color follows as the
+    // face opposite one of them. Returns false for facelets that are not real corners.
+    inline bool pocketCubie(const NxnState &state, CubieCube &c) {
+        auto pocketFacelet = [](int facelet) {
+            int n = facelet % FACELETS_PER_FACE;
+            return facelet / FACELETS_PER_FACE * 4 + n / 3 / 2 * 2 + n % 3 / 2;
+        };
+
+        uint8_t recolor[FACE_ID_COUNT] = {};
+        for (int k = 0; k < 3; k++) {
+            int facelet = CORNER_FACELETS[CORNER_DBL][k];
+            int color = state.facelets[pocketFacelet(facelet)];
+            int face = facelet / FACELETS_PER_FACE;
+            recolor[color] = static_cast<uint8_t>(face);
+            recolor[(color + 3) % FACE_ID_COUNT] = static_cast<uint8_t>((face + 3) % FACE_ID_COUNT);
+        }
+
+        CubeState cube = solvedState();
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            for (int k = 0; k < 3; k++) {
+                cube.facelets[CORNER_FACELETS[i][k]] = recolor[state.facelets[pocketFacelet(CORNER_FACELETS[i][k])]];
+            }
+        }
+        if (!faceletToCubie(cube, c)) {
+            return false;
+        }
+
+        // Any permutation of the corners is reachable here (the edges that would have to match
+        // its parity are not there); only repeated corners and the twist sum rule a state out
+        int seen = 0, twist = 0;
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            seen |= 1 << c.cp[i];
+            twist += c.co[i];
+        }
+        return seen == (1 << CORNER_COUNT) - 1 && c.cp[CORNER_DBL] == CORNER_DBL && c.co[CORNER_DBL] == 0 && twist % 3 == 0;
+    }
+
+    // Optimal: every step takes a move one closer to solved
+    inline Solution solvePocket(const CubieCube &c) {
+        const PocketMoveTables &moves = pocketMoveTables();
+        const uint8_t *table = pocketTable();
+
+        Solution solution;
+        uint32_t index = pocketIndex(c);
+        int depth = pruneDepth(table, index);
+        solution.length = depth;
+        for (int n = 0; n < solution.length; n++, depth--) {
+            for (int move = 0; move < POCKET_MOVE_COUNT; move++) {
+                uint32_t next = moves.apply(index, move);
+                if (pruneDepth(table, next) == depth - 1) {
+                    solution.moves[n] = static_cast<uint8_t>(move);
+                    index = next;
+                    break;
+                }
+            }
+        }
+        return solution;
+    }
+
+    inline Solution solvePocket(const NxnState &state) {
+        CubieCube c;
+        if (!pocketCubie(state, c)) {
+            return Solution();
+        }
+        return solvePocket(c);
+    }
+
+    constexpr bool pocketRoundTrip() {
+        for (uint32_t index = 0; index < POCKET_STATE_COUNT; index += 99991) {
+            if (pocketIndex(pocketCubie(index)) != index) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(pocketIndex(solvedCubie()) == 0, "solved pocket cube");
+    static_assert(pocketRoundTrip(), "pocket coordinate round trip");
+    static_assert(MOVE_CUBIES.move[8].cp[CORNER_DBL] == CORNER_DBL && MOVE_CUBIES.move[3].cp[CORNER_DBL] == CORNER_DBL, "U, R and F leave DBL in place");
+}
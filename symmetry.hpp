@@ -0,0 +1,301 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// The 16 symmetries of the cube that keep the U/D axis, and coordinate reduction by them.
+// Conjugating a cube by a symmetry (turning or mirroring the whole cube, colors included) keeps
+// its distance from solved, since the moves map onto moves. A coordinate is stored as the class
+// of equivalent coordinates plus the symmetry that takes it to the class representative, and a
+// pruning table over (coordinate, other coordinate) only needs an entry per class: the other
+// coordinate is conjugated by the same symmetry. These symmetries keep U/D facelets on U/D
+// faces, so twist, slice and slice permutation conjugate on their own (flip does not: a quarter
+// turn about U turns F/B facelets of slice edges into R/L ones).
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+
+#include "coord.hpp"
+
+namespace cube {
+    constexpr int SYMMETRY_COUNT = 16;
+    constexpr int SYM_F2 = 8; // half turn of the whole cube about the F axis, swapping U and D
+
+    // Classes under the 16 symmetries (reached by every coordinate, checked when built)
+    constexpr int SLICE_CLASS_COUNT = 45;
+    constexpr int CORNER_PERM_CLASS_COUNT = 2768;
+    constexpr int UD_EDGE_PERM_CLASS_COUNT = 2768;
+
+    // Symmetry s mirrors left/right if bit 0 is set, turns the cube (s >> 1 & 3) quarter turns
+    // clockwise about U and then swaps U and D by a half turn about F if bit 3 is set
+    constexpr Ivec3 symmetryTransform(int s, Ivec3 v) {
+        if (s & 1) {
+            v.x = -v.x;
+        }
+        for (int n = 0; n < (s >> 1 & 3); n++) {
+            v = turnClockwise(v, FACE_NORMAL[FACE_U]);
+        }
+        if (s & 8) {
+            v = {-v.x, -v.y, v.z};
+        }
+        return v;
+    }
+
+    struct Symmetry {
+        uint8_t facelet[FACELET_COUNT]; // where each facelet is moved to
+        uint8_t face[FACE_ID_COUNT];    // the face each face (and so each color) becomes
+        uint8_t corner[CORNER_COUNT];   // where each corner position is moved to
+        uint8_t edge[EDGE_COUNT];
+        uint8_t edgeFlip[EDGE_COUNT];   // 1 if the reference facelet of the position lands on the other one
+        uint8_t move[MOVE_COUNT];       // the move a move becomes
+        uint8_t inverse;
+        bool mirror;
+    };
+
+    struct Symmetries {
+        Symmetry sym[SYMMETRY_COUNT];
+    };
+
+    constexpr int faceWithNormal(Ivec3 normal) {
+        for (int face = 0; face < FACE_ID_COUNT; face++) {
+            if (FACE_NORMAL[face] == normal) {
+                return face;
+            }
+        }
+        return -1;
+    }
+
+    // Positions move with the cube and each cubie is renamed to the one whose home it lands on,
+    // so every orientation carries over except that a mirror reverses the clockwise order of
+    // corner facelets, and an edge flips when exactly one of its old and new positions (the
+    // position it sits in or its home) has its reference facelet turned away
+    constexpr CubieCube conjugate(const CubieCube &c, const Symmetry &s) {
+        CubieCube out{};
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            out.cp[s.corner[i]] = s.corner[c.cp[i]];
+            out.co[s.corner[i]] = s.mirror ? (3 - c.co[i]) % 3 : c.co[i];
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            out.ep[s.edge[i]] = s.edge[c.ep[i]];
+            out.eo[s.edge[i]] = c.eo[i] ^ s.edgeFlip[i] ^ s.edgeFlip[c.ep[i]];
+        }
+        return out;
+    }
+
+    constexpr CubeState conjugate(const CubeState &state, const Symmetry &s) {
+        CubeState out{};
+        for (int i = 0; i < FACELET_COUNT; i++) {
+            out.facelets[s.facelet[i]] = s.face[state.facelets[i]];
+        }
+        return out;
+    }
+
+    constexpr bool sameCubies(const CubieCube &a, const CubieCube &b) {
+        for (int i = 0; i < CORNER_COUNT; i++) {
+            if (a.cp[i] != b.cp[i] || a.co[i] != b.co[i]) {
+                return false;
+            }
+        }
+        for (int i = 0; i < EDGE_COUNT; i++) {
+            if (a.ep[i] != b.ep[i] || a.eo[i] != b.eo[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr Symmetries buildSymmetries() {
+        Symmetries table = {};
+        for (int s = 0; s < SYMMETRY_COUNT; s++) {
+            Symmetry &sym = table.sym[s];
+            for (int face = 0; face < FACE_ID_COUNT; face++) {
+                sym.face[face] = static_cast<uint8_t>(faceWithNormal(symmetryTransform(s, FACE_NORMAL[face])));
+            }
+            for (int i = 0; i < FACELET_COUNT; i++) {
+                sym.facelet[i] = static_cast<uint8_t>(faceletAt(symmetryTransform(s, faceletPosition(i)), FACE_NORMAL[sym.face[i / FACELETS_PER_FACE]]));
+            }
+            sym.mirror = dot(cross(symmetryTransform(s, {1, 0, 0}), symmetryTransform(s, {0, 1, 0})), symmetryTransform(s, {0, 0, 1})) < 0;
+
+            for (int i = 0; i < CORNER_COUNT; i++) {
+                for (int j = 0; j < CORNER_COUNT; j++) {
+                    if (CORNER_FACELETS[j][0] == sym.facelet[CORNER_FACELETS[i][0]]) {
+                        sym.corner[i] = static_cast<uint8_t>(j);
+                    }
+                }
+            }
+            for (int i = 0; i < EDGE_COUNT; i++) {
+                for (int j = 0; j < EDGE_COUNT; j++) {
+                    for (int k = 0; k < 2; k++) {
+                        if (EDGE_FACELETS[j][k] == sym.facelet[EDGE_FACELETS[i][0]]) {
+                            sym.edge[i] = static_cast<uint8_t>(j);
+                            sym.edgeFlip[i] = static_cast<uint8_t>(k);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int s = 0; s < SYMMETRY_COUNT; s++) {
+            for (int t = 0; t < SYMMETRY_COUNT; t++) {
+                if (symmetryTransform(t, symmetryTransform(s, {1, 2, 3})) == Ivec3{1, 2, 3}) {
+                    table.sym[s].inverse = static_cast<uint8_t>(t);
+                }
+            }
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                CubieCube conjugated = conjugate(MOVE_CUBIES.move[move], table.sym[s]);
+                for (int m = 0; m < MOVE_COUNT; m++) {
+                    if (sameCubies(conjugated, MOVE_CUBIES.move[m])) {
+                        table.sym[s].move[move] = static_cast<uint8_t>(m);
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    inline constexpr Symmetries SYMMETRIES = buildSymmetries();
+
+    /* Coordinate reduction */
+
+    // A reduced coordinate packs its class and the symmetry taking it to the representative
+    constexpr int symClass(uint16_t reduced) { return reduced >> 4; }
+    constexpr int symIndex(uint16_t reduced) { return reduced & 0xF; }
+
+    struct SymmetryTables {
+        uint16_t twistConj[TWIST_COUNT][SYMMETRY_COUNT];
+        uint16_t slicePermConj[SLICE_PERM_COUNT][SYMMETRY_COUNT];
+
+        uint16_t sliceSym[SLICE_COUNT];
+        uint16_t sliceRep[SLICE_CLASS_COUNT];
+        uint16_t sliceStabilizer[SLICE_CLASS_COUNT];
+        uint16_t cornerPermSym[CORNER_PERM_COUNT];
+        uint16_t cornerPermRep[CORNER_PERM_CLASS_COUNT];
+        uint16_t cornerPermStabilizer[CORNER_PERM_CLASS_COUNT]; // bit s set if s fixes the representative
+        uint16_t udEdgePermSym[UD_EDGE_PERM_COUNT];
+        uint16_t udEdgePermRep[UD_EDGE_PERM_CLASS_COUNT];
+        uint16_t udEdgePermStabilizer[UD_EDGE_PERM_CLASS_COUNT];
+    };
+
+    struct SymmetryLoadStats {
+        double seconds = 0.0;
+        bool classCountsMatch = false;
+    };
+
+    template <typename Set, typename Get>
+    int conjugateCoord(int coord, int s, Set set, Get get) {
+        CubieCube c = solvedCubie();
+        set(c, coord);
+        return get(conjugate(c, SYMMETRIES.sym[s]));
+    }
+
+    template <typename Set, typename Get>
+    void buildConjTable(uint16_t (*table)[SYMMETRY_COUNT], int count, Set set, Get get) {
+        for (int coord = 0; coord < count; coord++) {
+            for (int s = 0; s < SYMMETRY_COUNT; s++) {
+                table[coord][s] = static_cast<uint16_t>(conjugateCoord(coord, s, set, get));
+            }
+        }
+    }
+
+    // Coordinates in increasing order: the first of a class becomes its representative, and
+    // conjugating it by every symmetry finds the rest. Returns the number of classes.
+    template <typename Set, typename Get>
+    int buildSymClasses(uint16_t *sym, uint16_t *rep, uint16_t *stabilizer, int count, int classCapacity, Set set, Get get) {
+        const uint16_t UNSET = 0xFFFF;
+        std::fill(sym, sym + count, UNSET);
+        int classes = 0;
+        for (int coord = 0; coord < count; coord++) {
+            if (sym[coord] != UNSET) {
+                continue;
+            }
+            if (classes == classCapacity) {
+                return classes + 1;
+            }
+
+            uint16_t fixed = 0;
+            for (int s = 0; s < SYMMETRY_COUNT; s++) {
+                int conjugated = conjugateCoord(coord, s, set, get);
+                if (sym[conjugated] == UNSET) {
+                    sym[conjugated] = static_cast<uint16_t>(classes << 4 | SYMMETRIES.sym[s].inverse);
+                }
+                fixed |= static_cast<uint16_t>((conjugated == coord) << s);
+            }
+            rep[classes] = static_cast<uint16_t>(coord);
+            stabilizer[classes] = fixed;
+            classes++;
+        }
+        return classes;
+    }
+
+    inline void buildSymmetryTables(SymmetryTables &tables, bool *classCountsMatch = nullptr) {
+        buildConjTable(tables.twistConj, TWIST_COUNT, setTwist, getTwist);
+        buildConjTable(tables.slicePermConj, SLICE_PERM_COUNT, setSlicePerm, getSlicePerm);
+        int slices = buildSymClasses(tables.sliceSym, tables.sliceRep, tables.sliceStabilizer, SLICE_COUNT, SLICE_CLASS_COUNT, setSlice, getSlice);
+        int cornerPerms = buildSymClasses(tables.cornerPermSym, tables.cornerPermRep, tables.cornerPermStabilizer,
+                                          CORNER_PERM_COUNT, CORNER_PERM_CLASS_COUNT, setCornerPerm, getCornerPerm);
+        int udEdgePerms = buildSymClasses(tables.udEdgePermSym, tables.udEdgePermRep, tables.udEdgePermStabilizer,
+                                          UD_EDGE_PERM_COUNT, UD_EDGE_PERM_CLASS_COUNT, setUdEdgePerm, getUdEdgePerm);
+        if (classCountsMatch) {
+            *classCountsMatch = slices == SLICE_CLASS_COUNT && cornerPerms == CORNER_PERM_CLASS_COUNT && udEdgePerms == UD_EDGE_PERM_CLASS_COUNT;
+        }
+    }
+
+    // Built on first use, in about 20ms
+    inline const SymmetryTables &symmetryTables(SymmetryLoadStats *stats = nullptr) {
+        static SymmetryLoadStats loadStats;
+        static std::unique_ptr<SymmetryTables> tables = [] {
+            std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+            std::unique_ptr<SymmetryTables> built(new SymmetryTables);
+            buildSymmetryTables(*built, &loadStats.classCountsMatch);
+            loadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return built;
+        }();
+
+        if (stats) {
+            *stats = loadStats;
+        }
+        return *tables;
+    }
+
+    /* Compile-time checks */
+
+    constexpr bool conjugationMatchesFacelets(const CubieCube &c) {
+        for (int s = 0; s < SYMMETRY_COUNT; s++) {
+            CubieCube viaFacelets{};
+            if (!faceletToCubie(conjugate(cubieToFacelet(c), SYMMETRIES.sym[s]), viaFacelets) || !sameCubies(viaFacelets, conjugate(c, SYMMETRIES.sym[s]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool movesConjugateToMoves() {
+        for (int s = 0; s < SYMMETRY_COUNT; s++) {
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                if (!sameCubies(conjugate(MOVE_CUBIES.move[move], SYMMETRIES.sym[s]), MOVE_CUBIES.move[SYMMETRIES.sym[s].move[move]])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static_assert(conjugationMatchesFacelets(multiply(multiply(MOVE_CUBIES.move[3], MOVE_CUBIES.move[7]), MOVE_CUBIES.move[11])), "cubie conjugation matches the facelets");
+    static_assert(movesConjugateToMoves(), "symmetries map moves to moves");
+    static_assert(!SYMMETRIES.sym[SYM_F2].mirror && SYMMETRIES.sym[SYM_F2].face[FACE_U] == FACE_D && SYMMETRIES.sym[SYM_F2].face[FACE_F] == FACE_F, "F2 symmetry");
+    static_assert(SYMMETRIES.sym[1].mirror && SYMMETRIES.sym[1].move[3] == 14, "mirroring turns R into L'");
+}
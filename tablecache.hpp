@@ -0,0 +1,137 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Generated tables cached as files in the user cache directory
+// ($XDG_CACHE_HOME or ~/.cache). Every file starts with a small header so a table from an older
+// layout or a truncated write is rebuilt instead of being trusted. Small tables are read into
+// memory, large ones are mapped read-only so later runs start without reading them at all.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tablecache {
+    const uint32_t MAGIC = 0x52435453; // "RCTS"
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t bytes;
+    };
+
+    // Empty if no cache directory can be determined or created
+    inline std::string cacheDirectory() {
+        std::string base;
+        const char *xdg = getenv("XDG_CACHE_HOME");
+        const char *home = getenv("HOME");
+        if (xdg && *xdg) {
+            base = xdg;
+        } else if (home && *home) {
+            base = std::string(home) + "/.cache";
+        } else {
+            return "";
+        }
+
+        mkdir(base.c_str(), 0755);
+        std::string dir = base + "/rubiks-cube-terminal-screen-saver";
+        if (mkdir(dir.c_str(), 0755) != 0 && access(dir.c_str(), W_OK) != 0) {
+            return "";
+        }
+        return dir;
+    }
+
+    inline std::string cachePath(const char *name) {
+        std::string dir = cacheDirectory();
+        return dir.empty() ? "" : dir + "/" + name;
+    }
+
+    // Fills data from the cache file if it exists with the expected version and size
+    inline bool readTable(const char *name, uint32_t version, void *data, uint64_t bytes) {
+        std::string path = cachePath(name);
+        FILE *file = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+
+        Header header;
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+                  header.magic == MAGIC && header.version == version && header.bytes == bytes &&
+                  fread(data, 1, bytes, file) == bytes;
+        fclose(file);
+        return ok;
+    }
+
+    // Written to a temporary file and renamed so readers never see a partial table
+    inline bool writeTable(const char *name, uint32_t version, const void *data, uint64_t bytes) {
+        std::string path = cachePath(name);
+        if (path.empty()) {
+            return false;
+        }
+
+        std::string temporary = path + ".tmp" + std::to_string(getpid());
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+
+        Header header = {MAGIC, version, bytes};
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, 1, bytes, file) == bytes;
+        ok = (fclose(file) == 0) && ok;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Maps the table data read-only for the rest of the process; nullptr if the file is missing
+    // or stale. The data starts right after the header, so it is 16 byte aligned.
+    inline const uint8_t *mapTable(const char *name, uint32_t version, uint64_t bytes) {
+        std::string path = cachePath(name);
+        int fd = path.empty() ? -1 : open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        struct stat info;
+        uint64_t fileBytes = sizeof(Header) + bytes;
+        if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) != fileBytes) {
+            close(fd);
+            return nullptr;
+        }
+
+        void *base = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            return nullptr;
+        }
+
+        const Header *header = static_cast<const Header *>(base);
+        if (header->magic != MAGIC || header->version != version || header->bytes != bytes) {
+            munmap(base, fileBytes);
+            return nullptr;
+        }
+        return static_cast<const uint8_t *>(base) + sizeof(Header);
+    }
+}
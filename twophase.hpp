@@ -0,0 +1,328 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Two-phase (Kociemba) solver.
+// Phase 1 brings the cube into the subgroup <U, D, R2, L2, F2, B2> (no twist, no flip, slice
+// edges in the slice), phase 2 solves it with those moves only. Both phases are IDA* searches
+// over the coordinates from coord.hpp, bounded by pruning tables holding the exact distance of a
+// pair of coordinates in 4 bits. Three of the four tables index one coordinate of the pair by its
+// class under the 16 U/D symmetries (symmetry.hpp). The tables are generated once on every core,
+// cached as a single nibble-packed file and mapped read-only on later runs.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "coord.hpp"
+#include "depthtable.hpp"
+#include "symmetry.hpp"
+
+namespace cube {
+    /* Pruning tables */
+
+    enum PruneTableId {
+        PRUNE_TWIST_SLICE,        // slice class x twist
+        PRUNE_FLIP_SLICE,         // flip x slice, not reduced
+        PRUNE_CORNER_SLICE_PERM,  // corner permutation class x slice permutation
+        PRUNE_UD_EDGE_SLICE_PERM, // U/D edge permutation class x slice permutation
+        PRUNE_TABLE_COUNT
+    };
+
+    constexpr uint32_t PRUNE_TABLES_VERSION = 2;
+
+    constexpr uint32_t PRUNE_ENTRIES[PRUNE_TABLE_COUNT] = {
+        SLICE_CLASS_COUNT * TWIST_COUNT,
+        FLIP_COUNT * SLICE_COUNT,
+        CORNER_PERM_CLASS_COUNT * SLICE_PERM_COUNT,
+        UD_EDGE_PERM_CLASS_COUNT * SLICE_PERM_COUNT,
+    };
+
+    // 16 entries per 64 bit word, every table starting on a word in the file
+    constexpr uint32_t pruneWords(int table) { return (PRUNE_ENTRIES[table] + 15) / 16; }
+    constexpr uint32_t pruneWordOffset(int table) { return table == 0 ? 0 : pruneWordOffset(table - 1) + pruneWords(table - 1); }
+    constexpr uint64_t PRUNE_TABLES_BYTES = pruneWordOffset(PRUNE_TABLE_COUNT) * sizeof(uint64_t);
+
+    // Moves of the phase 2 subgroup: U, D, R2, F2, L2, B2
+    constexpr int PHASE2_MOVE_COUNT = 10;
+    constexpr int PHASE2_MOVES[PHASE2_MOVE_COUNT] = {0, 1, 2, 9, 10, 11, 4, 7, 13, 16};
+
+    struct PruneTables {
+        const uint8_t *table[PRUNE_TABLE_COUNT];
+    };
+
+    // A pruning table indexes the pair (a, b) as a * countB + b. When symA is set, a is the class
+    // of the first coordinate and b the second one conjugated by the symmetry symA names.
+    struct PruneSpace {
+        const uint16_t (*moveA)[MOVE_COUNT];
+        const uint16_t (*moveB)[MOVE_COUNT];
+        uint32_t countB;
+        bool phase2;
+        const uint16_t *symA = nullptr;
+        const uint16_t *repA = nullptr;
+        const uint16_t *stabilizerA = nullptr;
+        const uint16_t (*conjB)[SYMMETRY_COUNT] = nullptr;
+
+        uint32_t index(uint32_t a, uint32_t b) const {
+            if (!symA) {
+                return a * countB + b;
+            }
+            uint16_t reduced = symA[a];
+            return symClass(reduced) * countB + conjB[b][symIndex(reduced)];
+        }
+    };
+
+    inline PruneSpace pruneSpace(const CoordMoveTables &moves, const SymmetryTables &sym, int table) {
+        switch (table) {
+            case PRUNE_TWIST_SLICE:
+                return {moves.slice, moves.twist, TWIST_COUNT, false, sym.sliceSym, sym.sliceRep, sym.sliceStabilizer, sym.twistConj};
+            case PRUNE_FLIP_SLICE:
+                return {moves.flip, moves.slice, SLICE_COUNT, false};
+            case PRUNE_CORNER_SLICE_PERM:
+                return {moves.cornerPerm, moves.slicePerm, SLICE_PERM_COUNT, true, sym.cornerPermSym, sym.cornerPermRep, sym.cornerPermStabilizer, sym.slicePermConj};
+            default:
+                return {moves.udEdgePerm, moves.slicePerm, SLICE_PERM_COUNT, true, sym.udEdgePermSym, sym.udEdgePermRep, sym.udEdgePermStabilizer, sym.slicePermConj};
+        }
+    }
+
+    // The neighbors of a reduced entry are those of its class representative, and a neighbor
+    // whose representative is fixed by some symmetries stands for one entry per such symmetry
+    inline void generatePruneTable(uint64_t *words, const PruneSpace &space, uint32_t entries, int threads, DepthTableStats *stats = nullptr) {
+        int moves[MOVE_COUNT];
+        int moveCount = 0;
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            if (!space.phase2 || isPhase2Move(move)) {
+                moves[moveCount++] = move;
+            }
+        }
+
+        generateDepthTable(words, entries, 0, [&](uint32_t index, auto &&visit) {
+            uint32_t a = index / space.countB;
+            uint32_t b = index % space.countB;
+            if (!space.symA) {
+                for (int n = 0; n < moveCount; n++) {
+                    if (visit(space.moveA[a][moves[n]] * space.countB + space.moveB[b][moves[n]])) {
+                        return;
+                    }
+                }
+                return;
+            }
+
+            a = space.repA[a];
+            for (int n = 0; n < moveCount; n++) {
+                uint16_t reduced = space.symA[space.moveA[a][moves[n]]];
+                uint32_t neighborClass = symClass(reduced);
+                uint32_t neighborB = space.conjB[space.moveB[b][moves[n]]][symIndex(reduced)];
+                if (visit(neighborClass * space.countB + neighborB)) {
+                    return;
+                }
+                for (int s = 1; s < SYMMETRY_COUNT; s++) {
+                    if ((space.stabilizerA[neighborClass] >> s & 1) && visit(neighborClass * space.countB + space.conjB[neighborB][s])) {
+                        return;
+                    }
+                }
+            }
+        }, threads, stats);
+    }
+
+    inline void generatePruneTables(uint64_t *words, const CoordMoveTables &moves, const SymmetryTables &sym, int threads = parallel::threadCount()) {
+        for (int table = 0; table < PRUNE_TABLE_COUNT; table++) {
+            generatePruneTable(words + pruneWordOffset(table), pruneSpace(moves, sym, table), PRUNE_ENTRIES[table], threads);
+        }
+    }
+
+    // Mapped from the cache, or generated (and cached) on first use
+    inline const PruneTables &pruneTables(TableLoadStats *stats = nullptr) {
+        static TableLoadStats loadStats;
+        static std::vector<uint64_t> generated;
+        static PruneTables tables = [] {
+            std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+            const uint8_t *data = tablecache::mapTable("twophase-prune-tables.bin", PRUNE_TABLES_VERSION, PRUNE_TABLES_BYTES);
+            loadStats.fromCache = data != nullptr;
+            if (!data) {
+                const CoordMoveTables &moves = coordMoveTables();
+                loadStats.threads = parallel::threadCount();
+                generated.resize(PRUNE_TABLES_BYTES / sizeof(uint64_t));
+                generatePruneTables(generated.data(), moves, symmetryTables(), loadStats.threads);
+                tablecache::writeTable("twophase-prune-tables.bin", PRUNE_TABLES_VERSION, generated.data(), PRUNE_TABLES_BYTES);
+                data = reinterpret_cast<const uint8_t *>(generated.data());
+            }
+
+            PruneTables mapped;
+            for (int table = 0; table < PRUNE_TABLE_COUNT; table++) {
+                mapped.table[table] = data + pruneWordOffset(table) * sizeof(uint64_t);
+            }
+            loadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return mapped;
+        }();
+
+        if (stats) {
+            *stats = loadStats;
+        }
+        return tables;
+    }
+
+    /* Search */
+
+    constexpr int MAX_SOLUTION_LENGTH = 32;
+    constexpr int PHASE1_MAX_DEPTH = 12;
+    constexpr int PHASE2_MAX_DEPTH = 18;
+
+    struct Solution {
+        int length = -1; // -1 if the cube could not be read or is not solvable
+        uint8_t moves[MAX_SOLUTION_LENGTH];
+    };
+
+    struct TwoPhaseSearch {
+        const CoordMoveTables &moves;
+        const SymmetryTables &sym;
+        const PruneTables &prune;
+        CubieCube start;
+        int targetLength;
+        std::chrono::time_point<std::chrono::steady_clock> deadline;
+        uint8_t path[MAX_SOLUTION_LENGTH];
+        Solution best;
+        bool stop;
+    };
+
+    inline int phase1Bound(const TwoPhaseSearch &s, int twist, int flip, int slice) {
+        uint16_t sliceSym = s.sym.sliceSym[slice];
+        return std::max(pruneDepth(s.prune.table[PRUNE_TWIST_SLICE], symClass(sliceSym) * TWIST_COUNT + s.sym.twistConj[twist][symIndex(sliceSym)]),
+                        pruneDepth(s.prune.table[PRUNE_FLIP_SLICE], flip * SLICE_COUNT + slice));
+    }
+
+    inline int phase2Bound(const TwoPhaseSearch &s, int cornerPerm, int udEdgePerm, int slicePerm) {
+        uint16_t cornerSym = s.sym.cornerPermSym[cornerPerm];
+        uint16_t edgeSym = s.sym.udEdgePermSym[udEdgePerm];
+        return std::max(pruneDepth(s.prune.table[PRUNE_CORNER_SLICE_PERM], symClass(cornerSym) * SLICE_PERM_COUNT + s.sym.slicePermConj[slicePerm][symIndex(cornerSym)]),
+                        pruneDepth(s.prune.table[PRUNE_UD_EDGE_SLICE_PERM], symClass(edgeSym) * SLICE_PERM_COUNT + s.sym.slicePermConj[slicePerm][symIndex(edgeSym)]));
+    }
+
+    inline bool phase2Search(TwoPhaseSearch &s, int cornerPerm, int udEdgePerm, int slicePerm, int depth, int togo) {
+        if (togo == 0) {
+            return cornerPerm == 0 && udEdgePerm == 0 && slicePerm == 0;
+        }
+
+        int previous = depth ? s.path[depth - 1] : -1;
+        for (int n = 0; n < PHASE2_MOVE_COUNT; n++) {
+            int move = PHASE2_MOVES[n];
+            if (redundantMove(previous, move)) {
+                continue;
+            }
+
+            int nextCornerPerm = s.moves.cornerPerm[cornerPerm][move];
+            int nextUdEdgePerm = s.moves.udEdgePerm[udEdgePerm][move];
+            int nextSlicePerm = s.moves.slicePerm[slicePerm][move];
+            if (phase2Bound(s, nextCornerPerm, nextUdEdgePerm, nextSlicePerm) >= togo) {
+                continue;
+            }
+
+            s.path[depth] = static_cast<uint8_t>(move);
+            if (phase2Search(s, nextCornerPerm, nextUdEdgePerm, nextSlicePerm, depth + 1, togo - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Runs phase 2 from the end of a phase 1 sequence, only looking for solutions shorter than
+    // the best so far. Returns true once the search should stop.
+    inline bool startPhase2(TwoPhaseSearch &s, int depth1) {
+        int limit = std::min(PHASE2_MAX_DEPTH, (s.best.length < 0 ? MAX_SOLUTION_LENGTH : s.best.length - 1) - depth1);
+
+        // Phase 2 coordinates are not defined outside the subgroup, so replay phase 1 on the cubies
+        CubieCube c = s.start;
+        for (int n = 0; n < depth1; n++) {
+            c = multiply(c, MOVE_CUBIES.move[s.path[n]]);
+        }
+        int cornerPerm = getCornerPerm(c);
+        int udEdgePerm = getUdEdgePerm(c);
+        int slicePerm = getSlicePerm(c);
+
+        for (int togo = phase2Bound(s, cornerPerm, udEdgePerm, slicePerm); togo <= limit; togo++) {
+            if (phase2Search(s, cornerPerm, udEdgePerm, slicePerm, depth1, togo)) {
+                s.best.length = depth1 + togo;
+                memcpy(s.best.moves, s.path, s.best.length);
+                break;
+            }
+        }
+
+        s.stop = s.best.length >= 0 && (s.best.length <= s.targetLength || std::chrono::steady_clock::now() > s.deadline);
+        return s.stop;
+    }
+
+    inline bool phase1Search(TwoPhaseSearch &s, int twist, int flip, int slice, int depth, int togo) {
+        if (togo == 0) {
+            // Ending phase 1 on a phase 2 move only moves that move out of the phase 2 search
+            if (twist == 0 && flip == 0 && slice == 0 && (depth == 0 || !isPhase2Move(s.path[depth - 1]))) {
+                return startPhase2(s, depth);
+            }
+            return false;
+        }
+
+        int previous = depth ? s.path[depth - 1] : -1;
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            if (redundantMove(previous, move)) {
+                continue;
+            }
+
+            int nextTwist = s.moves.twist[twist][move];
+            int nextFlip = s.moves.flip[flip][move];
+            int nextSlice = s.moves.slice[slice][move];
+            if (phase1Bound(s, nextTwist, nextFlip, nextSlice) >= togo) {
+                continue;
+            }
+
+            s.path[depth] = static_cast<uint8_t>(move);
+            if (phase1Search(s, nextTwist, nextFlip, nextSlice, depth + 1, togo - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Keeps lengthening phase 1 while that can still shorten the solution, until one of at most
+    // targetLength moves is found or the time limit passes (the first solution is always returned)
+    inline Solution solveTwoPhase(const CubieCube &c, int targetLength = 22, double timeLimit = 0.1) {
+        TwoPhaseSearch s = {coordMoveTables(), symmetryTables(), pruneTables(), c, targetLength,
+                            std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeLimit)),
+                            {}, Solution(), false};
+
+        int twist = getTwist(c);
+        int flip = getFlip(c);
+        int slice = getSlice(c);
+        for (int depth1 = phase1Bound(s, twist, flip, slice); depth1 <= PHASE1_MAX_DEPTH; depth1++) {
+            if ((s.best.length >= 0 && depth1 >= s.best.length) || phase1Search(s, twist, flip, slice, 0, depth1)) {
+                break;
+            }
+        }
+        return s.best;
+    }
+
+    // Unsolvable states are rejected up front: the search would otherwise run to PHASE1_MAX_DEPTH,
+    // since the time limit only starts counting once a first solution is found
+    inline Solution solveTwoPhase(const CubeState &state, int targetLength = 22, double timeLimit = 0.1) {
+        CubieCube c;
+        if (!faceletToCubie(state, c) || !isSolvable(c)) {
+            return Solution();
+        }
+        return solveTwoPhase(c, targetLength, timeLimit);
+    }
+}
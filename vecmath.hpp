@@ -0,0 +1,269 @@
+// Rubiks-Cube-Terminal-Screen-Saver
+// Copyright (C) 2023 doprz
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Small header-only vector/matrix/quaternion library.
+// The vector, matrix and quaternion arithmetic is plain scalar code, constexpr wherever it can
+// be. Only the reciprocal square root and the four point coverage test have SSE paths, each
+// next to a scalar reference that --bench-vecmath checks it against.
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECMATH_SSE 1
+#else
+#define VECMATH_SSE 0
+#endif
+
+namespace vecmath {
+    struct Vec3 {
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+
+        constexpr float operator[](int i) const { return i == 0 ? x : i == 1 ? y : z; }
+    };
+
+    struct Vec4 {
+        float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+
+        constexpr float operator[](int i) const { return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
+    };
+
+    // Row-major
+    struct Mat3 {
+        Vec3 r[3];
+    };
+
+    struct Mat4 {
+        Vec4 r[4];
+    };
+
+    // Unit quaternion w + xi + yj + zk
+    struct Quat {
+        float w = 1.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+    };
+
+    /* Vec3 */
+
+    constexpr Vec3 operator+(Vec3 a, Vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+    constexpr Vec3 operator-(Vec3 a, Vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+    constexpr Vec3 operator-(Vec3 a) { return {-a.x, -a.y, -a.z}; }
+    constexpr Vec3 operator*(Vec3 a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+    constexpr Vec3 operator*(float s, Vec3 a) { return a * s; }
+    constexpr bool operator==(Vec3 a, Vec3 b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+
+    constexpr float dot(Vec3 a, Vec3 b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+
+    constexpr Vec3 cross(Vec3 a, Vec3 b) {
+        return {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+    }
+
+    constexpr Vec4 toVec4(Vec3 v, float w) { return {v.x, v.y, v.z, w}; }
+    constexpr Vec3 toVec3(Vec4 v) { return {v.x, v.y, v.z}; }
+
+    /* Vec4 */
+
+    constexpr Vec4 operator+(Vec4 a, Vec4 b) { return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+    constexpr Vec4 operator*(Vec4 a, float s) { return {a.x * s, a.y * s, a.z * s, a.w * s}; }
+    constexpr float dot(Vec4 a, Vec4 b) { return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w; }
+
+    /* Reciprocal square root */
+
+    inline float rsqrtScalar(float v) { return 1.0f / sqrtf(v); }
+
+    // rsqrtss estimate refined with one Newton-Raphson step (~23 bits), scalar fallback otherwise
+    inline float rsqrt(float v) {
+#if VECMATH_SSE
+        float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(v)));
+        return y * (1.5f - 0.5f * v * y * y);
+#else
+        return rsqrtScalar(v);
+#endif
+    }
+
+    inline float length(Vec3 v) { return sqrtf(dot(v, v)); }
+
+    // Zero vectors are returned unchanged
+    inline Vec3 normalize(Vec3 v) {
+        float magSquared = dot(v, v);
+        return magSquared > 0.0f ? v * rsqrt(magSquared) : v;
+    }
+
+    /* Mat3 */
+
+    constexpr Mat3 identity3() {
+        return {{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}};
+    }
+
+    constexpr Vec3 operator*(const Mat3 &m, Vec3 v) {
+        return {dot(m.r[0], v), dot(m.r[1], v), dot(m.r[2], v)};
+    }
+
+    constexpr Vec3 column(const Mat3 &m, int c) {
+        return {m.r[0][c], m.r[1][c], m.r[2][c]};
+    }
+
+    constexpr Mat3 transpose(const Mat3 &m) {
+        return {{column(m, 0), column(m, 1), column(m, 2)}};
+    }
+
+    constexpr Mat3 operator*(const Mat3 &a, const Mat3 &b) {
+        Mat3 bt = transpose(b);
+        return {{
+            {dot(a.r[0], bt.r[0]), dot(a.r[0], bt.r[1]), dot(a.r[0], bt.r[2])},
+            {dot(a.r[1], bt.r[0]), dot(a.r[1], bt.r[1]), dot(a.r[1], bt.r[2])},
+            {dot(a.r[2], bt.r[0]), dot(a.r[2], bt.r[1]), dot(a.r[2], bt.r[2])}
+        }};
+    }
+
+    constexpr bool operator==(const Mat3 &a, const Mat3 &b) {
+        return a.r[0] == b.r[0] && a.r[1] == b.r[1] && a.r[2] == b.r[2];
+    }
+
+    /* Mat4 */
+
+    constexpr Mat4 identity4() {
+        return {{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f}}};
+    }
+
+    // Rotation/scale followed by a translation
+    constexpr Mat4 affine(const Mat3 &m, Vec3 t) {
+        return {{toVec4(m.r[0], t.x), toVec4(m.r[1], t.y), toVec4(m.r[2], t.z), {0.0f, 0.0f, 0.0f, 1.0f}}};
+    }
+
+    constexpr Vec4 operator*(const Mat4 &m, Vec4 v) {
+        return {dot(m.r[0], v), dot(m.r[1], v), dot(m.r[2], v), dot(m.r[3], v)};
+    }
+
+    // Affine transform of a point (w = 1); the projective row is ignored
+    constexpr Vec3 transformPoint(const Mat4 &m, Vec3 p) {
+        return {dot(m.r[0], toVec4(p, 1.0f)), dot(m.r[1], toVec4(p, 1.0f)), dot(m.r[2], toVec4(p, 1.0f))};
+    }
+
+    /* Quat */
+
+    constexpr Quat operator*(Quat a, Quat b) {
+        return {
+            a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z,
+            a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+            a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+            a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w
+        };
+    }
+
+    constexpr bool operator==(Quat a, Quat b) { return a.w == b.w && a.x == b.x && a.y == b.y && a.z == b.z; }
+
+    inline Quat normalize(Quat q) {
+        float magSquared = q.w*q.w + q.x*q.x + q.y*q.y + q.z*q.z;
+        if (magSquared <= 0.0f) {
+            return q;
+        }
+        float oomag = rsqrt(magSquared);
+        return {q.w * oomag, q.x * oomag, q.y * oomag, q.z * oomag};
+    }
+
+    // Axis must be unit length
+    inline Quat quatFromAxisAngle(Vec3 axis, float angle) {
+        float s = sinf(angle / 2);
+        return {cosf(angle / 2), axis.x * s, axis.y * s, axis.z * s};
+    }
+
+    // Rz(a) * Ry(b) * Rx(c)
+    inline Quat quatFromEuler(float a, float b, float c) {
+        return quatFromAxisAngle({0.0f, 0.0f, 1.0f}, a) * quatFromAxisAngle({0.0f, 1.0f, 0.0f}, b) * quatFromAxisAngle({1.0f, 0.0f, 0.0f}, c);
+    }
+
+    constexpr Mat3 toMat3(Quat q) {
+        float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+        float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+        float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+
+        return {{
+            {1 - 2*(yy + zz), 2*(xy - wz), 2*(xz + wy)},
+            {2*(xy + wz), 1 - 2*(xx + zz), 2*(yz - wx)},
+            {2*(xz - wy), 2*(yz + wx), 1 - 2*(xx + yy)}
+        }};
+    }
+
+    constexpr Vec3 rotate(Quat q, Vec3 v) {
+        // v + 2w(u x v) + 2u x (u x v), u = vector part
+        Vec3 u = {q.x, q.y, q.z};
+        Vec3 t = cross(u, v) * 2.0f;
+        return v + t * q.w + cross(u, t);
+    }
+
+    /* Batch transforms */
+
+    // Affine transform of count points stored as structure of arrays. Output arrays may alias the inputs.
+    inline void transformPoints(const Mat4 &m, const float *x, const float *y, const float *z,
+                                float *outX, float *outY, float *outZ, size_t count) {
+        for (size_t n = 0; n < count; n++) {
+            Vec3 p = transformPoint(m, {x[n], y[n], z[n]});
+            outX[n] = p.x;
+            outY[n] = p.y;
+            outZ[n] = p.z;
+        }
+    }
+
+    /* Coverage */
+
+    inline unsigned insideConvex4Scalar(const float *a, const float *b, const float *c, int edges, const float px[4], const float py[4]) {
+        unsigned mask = 0;
+        for (int n = 0; n < 4; n++) {
+            bool inside = true;
+            for (int e = 0; e < edges; e++) {
+                inside = inside && (a[e]*px[n] + b[e]*py[n] + c[e] >= 0.0f);
+            }
+            mask |= inside ? (1u << n) : 0u;
+        }
+        return mask;
+    }
+
+    // Tests four points against a convex polygon given as edge functions a*x + b*y + c >= 0 (inside).
+    // Returns a 4-bit mask, bit n set when point n is inside every edge.
+    inline unsigned insideConvex4(const float *a, const float *b, const float *c, int edges, const float px[4], const float py[4]) {
+#if VECMATH_SSE
+        __m128 x = _mm_loadu_ps(px);
+        __m128 y = _mm_loadu_ps(py);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 zero = _mm_setzero_ps();
+
+        for (int e = 0; e < edges; e++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[e]), x), _mm_mul_ps(_mm_set1_ps(b[e]), y)), _mm_set1_ps(c[e]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+        }
+        return _mm_movemask_ps(inside);
+#else
+        return insideConvex4Scalar(a, b, c, edges, px, py);
+#endif
+    }
+
+    /* Compile-time checks */
+
+    static_assert(dot(Vec3{1.0f, 2.0f, 3.0f}, Vec3{4.0f, 5.0f, 6.0f}) == 32.0f, "dot");
+    static_assert(cross(Vec3{1.0f, 0.0f, 0.0f}, Vec3{0.0f, 1.0f, 0.0f}) == Vec3{0.0f, 0.0f, 1.0f}, "cross");
+    static_assert(identity3() * Vec3{1.0f, 2.0f, 3.0f} == Vec3{1.0f, 2.0f, 3.0f}, "Mat3 * Vec3");
+    static_assert(transpose(Mat3{{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}}) == Mat3{{{1, 4, 7}, {2, 5, 8}, {3, 6, 9}}}, "transpose");
+    static_assert(Mat3{{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}} * identity3() == Mat3{{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}}}, "Mat3 * Mat3");
+    static_assert(transformPoint(affine(identity3(), {0.0f, 0.0f, 10.0f}), {1.0f, 2.0f, 3.0f}) == Vec3{1.0f, 2.0f, 13.0f}, "affine");
+    static_assert(Quat{} * Quat{0.0f, 0.0f, 0.0f, 1.0f} == Quat{0.0f, 0.0f, 0.0f, 1.0f}, "Quat identity");
+    // 180 degrees about z
+    static_assert(toMat3(Quat{0.0f, 0.0f, 0.0f, 1.0f}) == Mat3{{{-1, 0, 0}, {0, -1, 0}, {0, 0, 1}}}, "Quat to Mat3");
+    static_assert(rotate(Quat{0.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 2.0f, 3.0f}) == Vec3{-1.0f, -2.0f, 3.0f}, "Quat rotate");
+    static_assert(toMat3(Quat{0.0f, 1.0f, 0.0f, 0.0f}) * Vec3{1.0f, 2.0f, 3.0f} == rotate(Quat{0.0f, 1.0f, 0.0f, 0.0f}, {1.0f, 2.0f, 3.0f}), "Mat3 and Quat agree");
+}